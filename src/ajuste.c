@@ -0,0 +1,248 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "ajuste.h"
+#include "heap.h"
+#include "pool.h"
+
+// Operações (pontos de treino x pontos de teste x dimensões) por medição
+#define ORCAMENTO_AMOSTRA 20000000.0
+#define AMOSTRA_MINIMA 8
+#define REPETICOES 2
+
+static double agora(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + t.tv_usec / 1000000.0;
+}
+
+// Lê um tamanho de cache no formato do sysfs ("32K", "8M")
+static long ler_tamanho(const char *caminho) {
+  FILE *f = fopen(caminho, "r");
+  if (!f) return 0;
+  long valor = 0;
+  char unidade = 0;
+  int lidos = fscanf(f, "%ld%c", &valor, &unidade);
+  fclose(f);
+  if (lidos < 1) return 0;
+  if (unidade == 'K') valor *= 1024;
+  if (unidade == 'M') valor *= 1024 * 1024;
+  return valor;
+}
+
+void ajuste_detectar_topologia(Topologia *topo) {
+  long nucleos = sysconf(_SC_NPROCESSORS_ONLN);
+  topo->nucleos = nucleos > 0 ? (int) nucleos : 1;
+  topo->cache_l1 = topo->cache_l2 = topo->cache_l3 = 0;
+
+  for (int i = 0; i < 8; i++) {
+    char caminho[128], tipo[32] = "";
+    int nivel = 0;
+
+    snprintf(caminho, sizeof(caminho), "/sys/devices/system/cpu/cpu0/cache/index%d/level", i);
+    FILE *f = fopen(caminho, "r");
+    if (!f) break;
+    if (fscanf(f, "%d", &nivel) != 1) nivel = 0;
+    fclose(f);
+
+    snprintf(caminho, sizeof(caminho), "/sys/devices/system/cpu/cpu0/cache/index%d/type", i);
+    f = fopen(caminho, "r");
+    if (f) {
+      if (fscanf(f, "%31s", tipo) != 1) tipo[0] = '\0';
+      fclose(f);
+    }
+    if (strcmp(tipo, "Instruction") == 0) continue;
+
+    snprintf(caminho, sizeof(caminho), "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+    long tamanho = ler_tamanho(caminho);
+    if (nivel == 1) topo->cache_l1 = tamanho;
+    if (nivel == 2) topo->cache_l2 = tamanho;
+    if (nivel == 3) topo->cache_l3 = tamanho;
+  }
+
+  if (topo->cache_l1 <= 0) topo->cache_l1 = 32 * 1024;
+  if (topo->cache_l2 <= 0) topo->cache_l2 = 256 * 1024;
+}
+
+int ajuste_buscar(const char *arquivo, const Dataset *dataset, int nucleos,
+                  ConfigMotor *cfg) {
+  FILE *f = fopen(arquivo, "r");
+  if (!f) return -1;
+
+  char linha[256];
+  int achou = 0;
+  while (fgets(linha, sizeof(linha), f)) {
+    int N, M, D, K, n, threads, bq, bt;
+    char motor[32];
+    if (linha[0] == '#') continue;
+    if (sscanf(linha, "%d %d %d %d %d %31s %d %d %d", &N, &M, &D, &K, &n, motor,
+               &threads, &bq, &bt) != 9) {
+      continue;
+    }
+    int tipo = motor_de_nome(motor);
+    if (N != dataset->N || M != dataset->M || D != dataset->D || K != dataset->K ||
+        n != nucleos || tipo < 0 || threads <= 0) {
+      continue;
+    }
+    // Em caso de repetição, vale a última linha gravada
+    cfg->tipo = (TipoMotor) tipo;
+    cfg->num_threads = threads;
+    cfg->bloco_teste = bq;
+    cfg->bloco_treino = bt;
+    achou = 1;
+  }
+  fclose(f);
+  return achou ? 0 : -1;
+}
+
+int ajuste_gravar(const char *arquivo, const Dataset *dataset, int nucleos,
+                  const ConfigMotor *cfg, double tempo) {
+  FILE *teste = fopen(arquivo, "r");
+  int novo = teste == NULL;
+  if (teste) fclose(teste);
+
+  FILE *f = fopen(arquivo, "a");
+  if (!f) {
+    fprintf(stderr, "Erro ao gravar arquivo de ajuste %s\n", arquivo);
+    return -1;
+  }
+  if (novo) {
+    fprintf(f, "# N M D K nucleos motor threads bloco_teste bloco_treino tempo_amostra\n");
+  }
+  fprintf(f, "%d %d %d %d %d %s %d %d %d %.6f\n", dataset->N, dataset->M, dataset->D,
+          dataset->K, nucleos, motor_nome(cfg->tipo), cfg->num_threads,
+          cfg->bloco_teste, cfg->bloco_treino, tempo);
+  return fclose(f) == 0 ? 0 : -1;
+}
+
+int ajuste_candidatos(const Dataset *dataset, const Topologia *topo, ConfigMotor *cand) {
+  int n = 0;
+  long caches[3] = {topo->cache_l1, topo->cache_l2, topo->cache_l3};
+  int blocos_teste[2] = {8, 32};
+
+  for (int t = 1; n < AJUSTE_MAX_CANDIDATOS - 8; t *= 2) {
+    if (t > topo->nucleos) t = topo->nucleos;
+
+    cand[n++] = (ConfigMotor){MOTOR_FATIAS, t, 0, 0};
+    for (int c = 0; c < 3; c++) {
+      if (caches[c] <= 0) continue;
+      for (int b = 0; b < 2; b++) {
+        ConfigMotor cfg = {MOTOR_BLOCOS, t, 0, 0};
+        motor_blocos_padrao(&cfg, dataset->D, caches[c]);
+        cfg.bloco_teste = blocos_teste[b];
+        cand[n++] = cfg;
+      }
+    }
+    if (t == topo->nucleos) break;
+  }
+  return n;
+}
+
+int ajuste_medir(Dataset *dataset, const Topologia *topo, ConfigMotor *melhor,
+                 double *tempo) {
+  // A amostra é dimensionada para que cada medição custe cerca do orçamento
+  double custo_ponto = (double) dataset->N * dataset->D;
+  int S = (int) (ORCAMENTO_AMOSTRA / (custo_ponto > 0 ? custo_ponto : 1));
+  if (S < AMOSTRA_MINIMA) S = AMOSTRA_MINIMA;
+  if (S > dataset->M) S = dataset->M;
+  if (S <= 0) {
+    fprintf(stderr, "Erro: não há pontos de teste para o ajuste\n");
+    return -1;
+  }
+
+  ConfigMotor *cand = (ConfigMotor*) malloc(AJUSTE_MAX_CANDIDATOS * sizeof(ConfigMotor));
+  Ponto *amostra = (Ponto*) malloc(S * sizeof(Ponto));
+  Heap *heaps = (Heap*) malloc(S * sizeof(Heap));
+  if (!cand || !amostra || !heaps) {
+    fprintf(stderr, "Erro de alocação de memória no ajuste\n");
+    free(cand);
+    free(amostra);
+    free(heaps);
+    return -1;
+  }
+
+  // Pontos de teste igualmente espaçados
+  for (int i = 0; i < S; i++) {
+    amostra[i] = dataset->teste[(long) i * dataset->M / S];
+  }
+  for (int i = 0; i < S; i++) {
+    heap_init(&heaps[i], dataset->K);
+  }
+  Dataset parcial = *dataset;
+  parcial.teste = amostra;
+  parcial.M = S;
+
+  int n_cand = ajuste_candidatos(dataset, topo, cand);
+  printf("Ajuste automático: %d núcleos, L1 %ld KiB, L2 %ld KiB, L3 %ld KiB\n",
+         topo->nucleos, topo->cache_l1 / 1024, topo->cache_l2 / 1024,
+         topo->cache_l3 / 1024);
+  printf("Medindo %d configurações em %d pontos de teste...\n", n_cand, S);
+
+  int ret = -1;
+  *tempo = 0;
+  // Como na execução real, as threads já existem: criar e juntar o pool fica
+  // fora da medição. Os candidatos vêm agrupados pelo número de threads
+  Pool pool = {0};
+  for (int c = 0; c < n_cand; c++) {
+    if (pool.n != cand[c].num_threads) {
+      pool_destruir(&pool);
+      if (pool_criar(&pool, cand[c].num_threads) != 0) continue;
+    }
+
+    double menor = -1;
+    for (int r = 0; r < REPETICOES; r++) {
+      for (int i = 0; i < S; i++) heaps[i].n_elem = 0;
+      double ini = agora();
+      if (motor_executar_pool(&pool, &parcial, heaps, &cand[c]) != 0) {
+        menor = -1;
+        break;
+      }
+      double t = agora() - ini;
+      if (menor < 0 || t < menor) menor = t;
+    }
+    if (menor < 0) continue;
+
+    printf("  %-6s threads=%-3d bloco_teste=%-4d bloco_treino=%-7d %.6f s\n",
+           motor_nome(cand[c].tipo), cand[c].num_threads, cand[c].bloco_teste,
+           cand[c].bloco_treino, menor);
+    if (ret != 0 || menor < *tempo) {
+      *melhor = cand[c];
+      *tempo = menor;
+      ret = 0;
+    }
+  }
+  pool_destruir(&pool);
+
+  for (int i = 0; i < S; i++) {
+    heap_libera(&heaps[i]);
+  }
+  free(heaps);
+  free(amostra);
+  free(cand);
+  return ret;
+}
+
+int ajuste_automatico(Dataset *dataset, const char *arquivo, ConfigMotor *cfg) {
+  Topologia topo;
+  ajuste_detectar_topologia(&topo);
+
+  if (ajuste_buscar(arquivo, dataset, topo.nucleos, cfg) == 0) {
+    printf("Configuração carregada de %s\n", arquivo);
+    return 0;
+  }
+
+  double tempo;
+  if (ajuste_medir(dataset, &topo, cfg, &tempo) != 0) {
+    fprintf(stderr, "Erro: nenhuma configuração pôde ser medida\n");
+    return -1;
+  }
+  if (ajuste_gravar(arquivo, dataset, topo.nucleos, cfg, tempo) == 0) {
+    printf("Configuração gravada em %s\n", arquivo);
+  }
+  return 0;
+}
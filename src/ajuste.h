@@ -0,0 +1,92 @@
+/**
+ * @file ajuste.h
+ * @brief Escolha automática do motor e de seus parâmetros (`--auto`).
+ *
+ * O ajuste mede, em uma amostra dos pontos de teste, o tempo de várias
+ * configurações candidatas (motor, número de threads e tamanhos de bloco),
+ * geradas a partir do número de núcleos e dos tamanhos de cache da máquina, e
+ * escolhe a mais rápida. O resultado é guardado em um arquivo texto, indexado
+ * pelo formato do dataset (N, M, D, K) e pelo número de núcleos, para que
+ * execuções seguintes com o mesmo formato não precisem repetir as medições.
+ */
+
+#ifndef AJUSTE_H
+#define AJUSTE_H
+
+#include "knn.h"
+#include "motor.h"
+
+#define AJUSTE_ARQUIVO_PADRAO "knn_tuning.txt" /**< Arquivo de ajuste padrão. */
+#define AJUSTE_MAX_CANDIDATOS 128 /**< Máximo de configurações candidatas. */
+
+/**
+ * @brief Núcleos e caches da máquina.
+ */
+typedef struct {
+  int nucleos;    /**< Número de processadores disponíveis. */
+  long cache_l1;  /**< Cache L1 de dados, em bytes. */
+  long cache_l2;  /**< Cache L2, em bytes. */
+  long cache_l3;  /**< Cache L3, em bytes (0 se ausente). */
+} Topologia;
+
+/**
+ * @brief Detecta o número de núcleos e os tamanhos de cache.
+ *
+ * @details As caches são lidas de `/sys/devices/system/cpu/cpu0/cache`; se a
+ * informação não estiver disponível, são usados 32 KiB (L1) e 256 KiB (L2).
+ */
+void ajuste_detectar_topologia(Topologia *topo);
+
+/**
+ * @brief Procura no arquivo de ajuste uma configuração para o formato dado.
+ *
+ * @return 0 se encontrou (e preencheu `cfg`), -1 caso contrário.
+ */
+int ajuste_buscar(const char *arquivo, const Dataset *dataset, int nucleos,
+                  ConfigMotor *cfg);
+
+/**
+ * @brief Acrescenta uma configuração ao arquivo de ajuste.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int ajuste_gravar(const char *arquivo, const Dataset *dataset, int nucleos,
+                  const ConfigMotor *cfg, double tempo);
+
+/**
+ * @brief Gera as configurações candidatas para a topologia dada.
+ *
+ * @details Para cada número de threads (potências de 2 até o número de
+ * núcleos), inclui o motor fatias e o motor blocos com blocos de treino
+ * dimensionados para cada nível de cache e dois tamanhos de bloco de teste.
+ *
+ * @param dataset Dataset (apenas D é usado).
+ * @param topo Topologia da máquina.
+ * @param cand Vetor com espaço para ::AJUSTE_MAX_CANDIDATOS configurações.
+ * @return Número de configurações geradas.
+ */
+int ajuste_candidatos(const Dataset *dataset, const Topologia *topo, ConfigMotor *cand);
+
+/**
+ * @brief Mede as configurações candidatas em uma amostra dos pontos de teste.
+ *
+ * @param dataset Dataset com treino e teste carregados.
+ * @param topo Topologia da máquina.
+ * @param melhor Recebe a configuração mais rápida.
+ * @param tempo Recebe o tempo da melhor configuração na amostra (segundos).
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int ajuste_medir(Dataset *dataset, const Topologia *topo, ConfigMotor *melhor,
+                 double *tempo);
+
+/**
+ * @brief Obtém a configuração do arquivo de ajuste ou, se não houver, mede e grava.
+ *
+ * @param dataset Dataset com treino e teste carregados.
+ * @param arquivo Arquivo de ajuste.
+ * @param cfg Recebe a configuração escolhida.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int ajuste_automatico(Dataset *dataset, const char *arquivo, ConfigMotor *cfg);
+
+#endif // !AJUSTE_H
@@ -0,0 +1,134 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "autojuncao.h"
+#include "trace.h"
+#include "utils.h"
+
+/**
+ * @brief Estado compartilhado pelas threads do self-join.
+ */
+typedef struct {
+  Dataset *dataset;      /**< Dataset com o conjunto de treino. */
+  Heap *heaps;           /**< Uma heap por ponto de treino. */
+  int bloco;             /**< Lado dos blocos. */
+  long n_blocos;         /**< Blocos por lado da matriz de pares. */
+  long total;            /**< Blocos do triângulo superior. */
+  long proximo;          /**< Próximo bloco a ser entregue. */
+  pthread_mutex_t mutex; /**< Protege `proximo` e `erro`. */
+  int erro;              /**< Diferente de zero se alguma thread falhou. */
+} AgendaTriangular;
+
+static void marcar_erro(AgendaTriangular *ag) {
+  pthread_mutex_lock(&ag->mutex);
+  ag->erro = 1;
+  pthread_mutex_unlock(&ag->mutex);
+}
+
+// Converte o índice linear `t` do triângulo superior no par de blocos (bi, bj)
+static void bloco_do_indice(long t, long nb, long *bi, long *bj) {
+  // A linha bi começa no índice bi * nb - bi * (bi - 1) / 2
+  long i = (long) ((2 * nb + 1 - sqrt((double) (2 * nb + 1) * (2 * nb + 1) - 8.0 * t)) / 2);
+  if (i < 0) i = 0;
+  while (i > 0 && i * nb - i * (i - 1) / 2 > t) i--;
+  while ((i + 1) * nb - (i + 1) * i / 2 <= t) i++;
+  *bi = i;
+  *bj = i + (t - (i * nb - i * (i - 1) / 2));
+}
+
+static void *autojuncao_worker(void *args) {
+  AgendaTriangular *ag = (AgendaTriangular*) args;
+  Ponto *treino = ag->dataset->treino;
+  int N = ag->dataset->N;
+  int dim = ag->dataset->D;
+  int B = ag->bloco;
+
+  // Distâncias do bloco atual, usadas nas duas direções
+  double *dists = (double*) malloc((size_t) B * B * sizeof(double));
+  if (!dists) {
+    fprintf(stderr, "Erro de alocação de memória no self-join\n");
+    marcar_erro(ag);
+    return NULL;
+  }
+
+  for (;;) {
+    pthread_mutex_lock(&ag->mutex);
+    long t = ag->proximo++;
+    pthread_mutex_unlock(&ag->mutex);
+    if (t >= ag->total) break;
+
+    long bi, bj;
+    bloco_do_indice(t, ag->n_blocos, &bi, &bj);
+    int i_ini = (int) bi * B, i_fim = i_ini + B < N ? i_ini + B : N;
+    int j_ini = (int) bj * B, j_fim = j_ini + B < N ? j_ini + B : N;
+    int diagonal = bi == bj;
+    trace_inicio_faixa("bloco", t, t + 1);
+
+    for (int i = i_ini; i < i_fim; i++) {
+      // Na diagonal, só os pares com j > i (exclui o próprio ponto)
+      for (int j = diagonal ? i + 1 : j_ini; j < j_fim; j++) {
+        dists[(i - i_ini) * B + (j - j_ini)] = distancia(&treino[i], &treino[j], dim);
+      }
+    }
+
+    // Cada heap é travada uma vez por bloco, e não uma vez por par
+    for (int i = i_ini; i < i_fim; i++) {
+      Heap *p_heap = ag->heaps + i;
+      pthread_mutex_lock(&p_heap->mutex);
+      for (int j = diagonal ? i + 1 : j_ini; j < j_fim; j++) {
+        heap_inserir(p_heap, dists[(i - i_ini) * B + (j - j_ini)], treino[j].id);
+      }
+      pthread_mutex_unlock(&p_heap->mutex);
+    }
+    for (int j = j_ini; j < j_fim; j++) {
+      Heap *p_heap = ag->heaps + j;
+      int i_lim = diagonal ? j : i_fim;
+      pthread_mutex_lock(&p_heap->mutex);
+      for (int i = i_ini; i < i_lim; i++) {
+        heap_inserir(p_heap, dists[(i - i_ini) * B + (j - j_ini)], treino[i].id);
+      }
+      pthread_mutex_unlock(&p_heap->mutex);
+    }
+    trace_fim("bloco");
+  }
+
+  free(dists);
+  return NULL;
+}
+
+int autojuncao_executar(Dataset *dataset, Heap *heaps, int num_threads, int bloco) {
+  AgendaTriangular ag;
+  ag.dataset = dataset;
+  ag.heaps = heaps;
+  ag.bloco = bloco > 0 ? bloco : AUTOJUNCAO_BLOCO;
+  ag.n_blocos = (dataset->N + ag.bloco - 1) / ag.bloco;
+  ag.total = ag.n_blocos * (ag.n_blocos + 1) / 2;
+  ag.proximo = 0;
+  ag.erro = 0;
+  pthread_mutex_init(&ag.mutex, NULL);
+
+  pthread_t *threads = (pthread_t*) malloc(num_threads * sizeof(pthread_t));
+  if (!threads) {
+    fprintf(stderr, "Erro de alocação de memória para threads\n");
+    pthread_mutex_destroy(&ag.mutex);
+    return -1;
+  }
+
+  int criadas = 0;
+  for (; criadas < num_threads; criadas++) {
+    if (pthread_create(&threads[criadas], NULL, autojuncao_worker, &ag) != 0) {
+      fprintf(stderr, "Erro ao criar thread %d\n", criadas);
+      marcar_erro(&ag);
+      break;
+    }
+  }
+  for (int i = 0; i < criadas; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(threads);
+  pthread_mutex_destroy(&ag.mutex);
+  return ag.erro ? -1 : 0;
+}
@@ -0,0 +1,35 @@
+/**
+ * @file autojuncao.h
+ * @brief Grafo de K vizinhos do próprio conjunto de treino (*self-join*).
+ *
+ * Em vez de comparar o treino com uma cópia de si mesmo, cada par `(i, j)`
+ * com `i < j` tem sua distância calculada uma única vez e oferecida às heaps
+ * dos dois pontos, o que corta o trabalho pela metade. O próprio ponto nunca
+ * aparece entre seus vizinhos.
+ *
+ * Os pares são agrupados em blocos quadrados de `bloco x bloco` pontos, e só
+ * os blocos do triângulo superior (incluindo a diagonal) são processados. As
+ * threads retiram blocos de uma fila compartilhada, o que equilibra a carga
+ * mesmo com os blocos da diagonal custando metade dos demais.
+ */
+
+#ifndef AUTOJUNCAO_H
+#define AUTOJUNCAO_H
+
+#include "heap.h"
+#include "knn.h"
+
+#define AUTOJUNCAO_BLOCO 128 /**< Lado padrão dos blocos de pares. */
+
+/**
+ * @brief Calcula os K vizinhos de cada ponto de treino entre os demais.
+ *
+ * @param dataset Dataset com o conjunto de treino carregado.
+ * @param heaps Vetor de `dataset->N` heaps inicializadas com capacidade K.
+ * @param num_threads Número de threads a serem usadas.
+ * @param bloco Lado dos blocos de pares (`<= 0` usa ::AUTOJUNCAO_BLOCO).
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int autojuncao_executar(Dataset *dataset, Heap *heaps, int num_threads, int bloco);
+
+#endif // !AUTOJUNCAO_H
@@ -0,0 +1,355 @@
+/**
+ * @file avaliacao.c
+ * @brief Gabarito exato e avaliação de recall e vazão dos motores.
+ *
+ * Três subcomandos:
+ *
+ * - `gabarito`: calcula uma única vez o top-K exato e o grava em disco,
+ *   amarrado aos identificadores de conteúdo do treino e do teste.
+ * - `avaliar`: mede recall@K e razão de distâncias de um resultado já
+ *   gravado no formato parcial (knn_main --parcial ou knn_merge).
+ * - `varrer`: executa os motores em uma varredura de threads e tamanhos de
+ *   bloco, e a PQ em uma varredura de subespaços, bits e re-ranqueamento,
+ *   medindo recall, razão de distâncias e consultas por segundo, e grava as
+ *   curvas em CSV.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "ajuste.h"
+#include "formato.h"
+#include "gabarito.h"
+#include "heap.h"
+#include "knn.h"
+#include "libknn.h"
+#include "motor.h"
+#include "parcial.h"
+
+static double agora(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + t.tv_usec / 1000000.0;
+}
+
+static void exibir_uso(const char *programa) {
+  fprintf(stderr, "Uso:\n");
+  fprintf(stderr, "  %s gabarito <treino> <teste> <K> <N_THREADS> <saida.gt>\n", programa);
+  fprintf(stderr, "  %s avaliar <gabarito.gt> <treino> <teste> <resultado.part>\n", programa);
+  fprintf(stderr, "  %s varrer <gabarito.gt> <treino> <teste> [curvas.csv]\n", programa);
+  fprintf(stderr, "  gabarito: calcula e grava o top-K exato\n");
+  fprintf(stderr, "  avaliar: mede recall@K e razão de distâncias de um arquivo parcial\n");
+  fprintf(stderr, "  varrer: mede recall, razão e consultas/s dos motores em várias configurações\n");
+  fprintf(stderr, "Exemplo: %s gabarito train.bin test.bin 10 4 knn.gt\n", programa);
+}
+
+/**
+ * @brief Lê um dataset inteiro e calcula seu identificador de conteúdo.
+ */
+static int carregar_conjunto(const char *arquivo, Ponto **pontos, int *n, int *d,
+                             uint64_t *id) {
+  ArquivoDataset arq;
+  if (formato_abrir(arquivo, &arq) != 0) {
+    fprintf(stderr, "Falha ao abrir dataset: %s\n", arquivo);
+    return -1;
+  }
+  *n = (int) arq.cab.n;
+  *d = (int) arq.cab.d;
+  int ret = formato_identificador(&arq, id);
+  if (ret == 0) ret = formato_ler_pontos(&arq, 0, *n, pontos);
+  formato_fechar(&arq);
+  return ret;
+}
+
+/**
+ * @brief Carrega treino e teste e confere a compatibilidade das dimensões.
+ */
+static int carregar(Dataset *dataset, const char *treino, const char *teste, int K,
+                    uint64_t *id_treino, uint64_t *id_teste) {
+  int d_treino, d_teste;
+  dataset->K = K;
+  if (carregar_conjunto(treino, &dataset->treino, &dataset->N, &d_treino, id_treino) != 0) {
+    return -1;
+  }
+  if (carregar_conjunto(teste, &dataset->teste, &dataset->M, &d_teste, id_teste) != 0) {
+    formato_liberar_pontos(dataset->treino, dataset->N);
+    return -1;
+  }
+  dataset->D = d_treino;
+  if (d_treino != d_teste) {
+    fprintf(stderr, "Erro: Dimensões incompatíveis - treino: %d, teste: %d\n",
+            d_treino, d_teste);
+  } else if (K <= 0 || K > dataset->N) {
+    fprintf(stderr, "Erro: K deve estar entre 1 e %d (número de pontos de treino)\n",
+            dataset->N);
+  } else {
+    return 0;
+  }
+  formato_liberar_pontos(dataset->treino, dataset->N);
+  formato_liberar_pontos(dataset->teste, dataset->M);
+  return -1;
+}
+
+static void liberar(Dataset *dataset) {
+  formato_liberar_pontos(dataset->treino, dataset->N);
+  formato_liberar_pontos(dataset->teste, dataset->M);
+}
+
+/**
+ * @brief Executa um motor e devolve os vizinhos ordenados e o tempo gasto.
+ *
+ * @param ctx Se não for NULL, a busca é feita pelo contexto e `cfg` é ignorado.
+ * @param saida Vetor com espaço para `M * K` vizinhos.
+ */
+static int executar(Dataset *dataset, const ConfigMotor *cfg, KnnContexto *ctx,
+                    Vizinho *saida, double *tempo) {
+  int M = dataset->M, K = dataset->K;
+  Heap *heaps = (Heap*) malloc(M * sizeof(Heap));
+  HeapElem *ordenados = (HeapElem*) malloc(K * sizeof(HeapElem));
+  if (!heaps || !ordenados) {
+    fprintf(stderr, "Erro de alocação de memória para as heaps\n");
+    free(heaps);
+    free(ordenados);
+    return -1;
+  }
+  for (int i = 0; i < M; i++) heap_init(&heaps[i], K);
+
+  double ini = agora();
+  int ret = ctx ? knn_query_points(ctx, dataset->teste, M, K, heaps)
+                : motor_executar(dataset, heaps, cfg);
+  *tempo = agora() - ini;
+
+  for (int i = 0; i < M; i++) {
+    if (ret == 0) parcial_linha_de_heap(&heaps[i], K, ordenados, saida + (size_t) i * K);
+    heap_libera(&heaps[i]);
+  }
+  free(heaps);
+  free(ordenados);
+  return ret;
+}
+
+/**
+ * @brief Carrega datasets e gabarito e confere se correspondem.
+ */
+static int preparar(const char *arquivo_gabarito, const char *treino, const char *teste,
+                    Gabarito *g, Dataset *dataset) {
+  uint64_t id_treino, id_teste;
+  if (gabarito_ler(arquivo_gabarito, g) != 0) return -1;
+  if (carregar(dataset, treino, teste, (int) g->cab.k, &id_treino, &id_teste) != 0) {
+    gabarito_libera(g);
+    return -1;
+  }
+  if (gabarito_conferir(g, dataset, id_treino, id_teste) != 0) {
+    liberar(dataset);
+    gabarito_libera(g);
+    return -1;
+  }
+  return 0;
+}
+
+static int comando_gabarito(int argc, char *argv[]) {
+  if (argc != 7) {
+    exibir_uso(argv[0]);
+    return 1;
+  }
+  int K = atoi(argv[4]);
+  int num_threads = atoi(argv[5]);
+  if (num_threads <= 0) {
+    fprintf(stderr, "Erro: Número de threads deve ser positivo\n");
+    return 1;
+  }
+
+  Dataset dataset;
+  CabecalhoGabarito cab = {.k = K};
+  if (carregar(&dataset, argv[2], argv[3], K, &cab.id_treino, &cab.id_teste) != 0) {
+    return 1;
+  }
+  cab.m = dataset.M;
+  cab.n = dataset.N;
+  cab.d = dataset.D;
+
+  Topologia topo;
+  ajuste_detectar_topologia(&topo);
+  ConfigMotor cfg = {MOTOR_BLOCOS, num_threads, 0, 0};
+  motor_blocos_padrao(&cfg, dataset.D, topo.cache_l2);
+
+  Vizinho *vizinhos = (Vizinho*) malloc((size_t) dataset.M * K * sizeof(Vizinho));
+  double tempo = 0;
+  int ret = vizinhos ? 0 : 1;
+  if (ret == 0) {
+    printf("Calculando top-%d exato de %d consultas em %d pontos de treino...\n",
+           K, dataset.M, dataset.N);
+    if (executar(&dataset, &cfg, NULL, vizinhos, &tempo) != 0 ||
+        gabarito_gravar(argv[6], &cab, vizinhos) != 0) {
+      ret = 1;
+    }
+  }
+
+  free(vizinhos);
+  liberar(&dataset);
+  if (ret != 0) {
+    fprintf(stderr, "Falha ao gerar o gabarito\n");
+    return 1;
+  }
+  printf("Gabarito salvo em %s (%.6f segundos)\n", argv[6], tempo);
+  return 0;
+}
+
+static int comando_avaliar(int argc, char *argv[]) {
+  if (argc != 6) {
+    exibir_uso(argv[0]);
+    return 1;
+  }
+
+  Gabarito g;
+  Dataset dataset;
+  if (preparar(argv[2], argv[3], argv[4], &g, &dataset) != 0) return 1;
+
+  ArquivoParcial arq;
+  Vizinho *resultado = NULL;
+  Metricas m;
+  int ret = parcial_abrir(argv[5], &arq) == 0 ? 0 : 1;
+  if (ret == 0) {
+    if (arq.cab.m != g.cab.m) {
+      fprintf(stderr, "Erro: %s tem M=%u, o gabarito tem M=%u\n", argv[5], arq.cab.m,
+              g.cab.m);
+      ret = 1;
+    } else {
+      resultado = (Vizinho*) malloc((size_t) arq.cab.m * arq.cab.k * sizeof(Vizinho));
+      if (!resultado || parcial_ler(&arq, 0, (int) arq.cab.m, resultado) != 0 ||
+          gabarito_avaliar(&g, &dataset, resultado, (int) arq.cab.k, &m) != 0) {
+        ret = 1;
+      }
+    }
+    parcial_fechar(&arq);
+  }
+
+  if (ret == 0) {
+    printf("Consultas: %u, K: %u\n", g.cab.m, g.cab.k);
+    printf("Recall@%u: %.6f\n", g.cab.k, m.recall);
+    printf("Razão de distâncias: %.6f\n", m.razao);
+    if (m.invalidos > 0) {
+      printf("Vizinhos inválidos (id -1, fora do treino ou repetido): %ld\n",
+             m.invalidos);
+    }
+  }
+
+  free(resultado);
+  liberar(&dataset);
+  gabarito_libera(&g);
+  return ret;
+}
+
+static int comando_varrer(int argc, char *argv[]) {
+  if (argc != 5 && argc != 6) {
+    exibir_uso(argv[0]);
+    return 1;
+  }
+  const char *arquivo_csv = argc == 6 ? argv[5] : "curvas.csv";
+
+  Gabarito g;
+  Dataset dataset;
+  if (preparar(argv[2], argv[3], argv[4], &g, &dataset) != 0) return 1;
+
+  FILE *csv = fopen(arquivo_csv, "w");
+  ConfigMotor *cand = (ConfigMotor*) malloc(AJUSTE_MAX_CANDIDATOS * sizeof(ConfigMotor));
+  Vizinho *resultado = (Vizinho*) malloc((size_t) dataset.M * dataset.K * sizeof(Vizinho));
+  if (!csv || !cand || !resultado) {
+    fprintf(stderr, "Erro ao preparar a varredura (arquivo %s)\n", arquivo_csv);
+    if (csv) fclose(csv);
+    free(cand);
+    free(resultado);
+    liberar(&dataset);
+    gabarito_libera(&g);
+    return 1;
+  }
+
+  Topologia topo;
+  ajuste_detectar_topologia(&topo);
+  int n_cand = ajuste_candidatos(&dataset, &topo, cand);
+
+  fprintf(csv, "metodo,parametros,threads,recall,razao_distancia,consultas_por_segundo\n");
+  printf("%-8s %-36s %7s %9s %9s %14s\n", "metodo", "parametros", "threads", "recall",
+         "razao", "consultas/s");
+
+  int ret = 0;
+  for (int c = 0; c < n_cand && ret == 0; c++) {
+    double tempo;
+    Metricas m;
+    if (executar(&dataset, &cand[c], NULL, resultado, &tempo) != 0 ||
+        gabarito_avaliar(&g, &dataset, resultado, dataset.K, &m) != 0) {
+      ret = 1;
+      break;
+    }
+
+    char parametros[64] = "-";
+    if (cand[c].tipo == MOTOR_BLOCOS) {
+      snprintf(parametros, sizeof(parametros), "bloco_teste=%d;bloco_treino=%d",
+               cand[c].bloco_teste, cand[c].bloco_treino);
+    }
+    double qps = tempo > 0 ? dataset.M / tempo : 0;
+    printf("%-8s %-36s %7d %9.6f %9.6f %14.1f\n", motor_nome(cand[c].tipo),
+           parametros, cand[c].num_threads, m.recall, m.razao, qps);
+    fprintf(csv, "%s,%s,%d,%.6f,%.6f,%.3f\n", motor_nome(cand[c].tipo), parametros,
+            cand[c].num_threads, m.recall, m.razao, qps);
+  }
+
+  // PQ: subespaços de 2, 4 e 8 dimensões, 8 e 4 bits, com e sem re-ranqueamento
+  KnnContexto *ctx = ret == 0 ? knn_create_from_points(dataset.treino, dataset.N, dataset.D,
+                                                       topo.nucleos) : NULL;
+  if (ret == 0 && !ctx) ret = 1;
+  for (int dsub = 2; ctx && dsub <= 8 && ret == 0; dsub *= 2) {
+    int m_pq = dataset.D / dsub;
+    if (dataset.D % dsub != 0) continue;
+    for (int bits = 8; bits >= 4 && ret == 0; bits -= 4) {
+      if ((bits == 4 && m_pq % 2 != 0) || dataset.N < (1 << bits)) continue;
+      ParametrosPQ params = {m_pq, bits, 0, NULL};
+      if (knn_build_pq(ctx, &params) != 0) {
+        ret = 1;
+        break;
+      }
+      int reranks[2] = {0, 4 * dataset.K};
+      for (int r = 0; r < 2 && ret == 0; r++) {
+        double tempo;
+        Metricas m;
+        knn_set_rerank(ctx, reranks[r]);
+        if (executar(&dataset, NULL, ctx, resultado, &tempo) != 0 ||
+            gabarito_avaliar(&g, &dataset, resultado, dataset.K, &m) != 0) {
+          ret = 1;
+          break;
+        }
+        char parametros[64];
+        snprintf(parametros, sizeof(parametros), "m=%d;bits=%d;rerank=%d", m_pq, bits,
+                 reranks[r]);
+        double qps = tempo > 0 ? dataset.M / tempo : 0;
+        printf("%-8s %-36s %7d %9.6f %9.6f %14.1f\n", "pq", parametros, topo.nucleos,
+               m.recall, m.razao, qps);
+        fprintf(csv, "%s,%s,%d,%.6f,%.6f,%.3f\n", "pq", parametros, topo.nucleos, m.recall,
+                m.razao, qps);
+      }
+    }
+  }
+  knn_destroy(ctx);
+
+  if (fclose(csv) != 0) ret = 1;
+  free(cand);
+  free(resultado);
+  liberar(&dataset);
+  gabarito_libera(&g);
+  if (ret != 0) {
+    fprintf(stderr, "Falha na varredura\n");
+    return 1;
+  }
+  printf("Curvas salvas em %s\n", arquivo_csv);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc >= 2 && strcmp(argv[1], "gabarito") == 0) return comando_gabarito(argc, argv);
+  if (argc >= 2 && strcmp(argv[1], "avaliar") == 0) return comando_avaliar(argc, argv);
+  if (argc >= 2 && strcmp(argv[1], "varrer") == 0) return comando_varrer(argc, argv);
+  exibir_uso(argv[0]);
+  return 1;
+}
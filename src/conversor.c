@@ -0,0 +1,179 @@
+/**
+ * @file conversor.c
+ * @brief Conversor de datasets para o formato v2 ou esparso.
+ *
+ * Lê um dataset em qualquer formato suportado (legado ou v2, detectado
+ * automaticamente) e o grava no formato v2 com o tipo de dado pedido, ou no
+ * formato esparso (CSR, ver esparso.h) descartando as entradas nulas. Os
+ * pontos são processados em blocos, sem carregar o arquivo inteiro.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esparso.h"
+#include "formato.h"
+
+#define LINHAS_POR_BLOCO 4096
+
+/**
+ * @brief Maior valor absoluto do dataset, usado para calcular a escala int8.
+ */
+static int maior_absoluto(ArquivoDataset *arq, double *maior) {
+  int n = (int) arq->cab.n;
+  int d = (int) arq->cab.d;
+  *maior = 0;
+  for (int ini = 0; ini < n; ini += LINHAS_POR_BLOCO) {
+    int fim = ini + LINHAS_POR_BLOCO < n ? ini + LINHAS_POR_BLOCO : n;
+    Ponto *pontos;
+    if (formato_ler_pontos(arq, ini, fim, &pontos) != 0) return -1;
+    for (int i = 0; i < fim - ini; i++) {
+      for (int j = 0; j < d; j++) {
+        *maior = fmax(*maior, fabs(pontos[i].features[j]));
+      }
+    }
+    formato_liberar_pontos(pontos, fim - ini);
+  }
+  return 0;
+}
+
+/**
+ * @brief Grava o dataset no formato esparso, em duas passadas: a primeira
+ * conta as entradas não nulas e a segunda grava as linhas.
+ */
+static int converter_esparso(ArquivoDataset *entrada, const char *saida) {
+  int n = (int) entrada->cab.n;
+  int d = (int) entrada->cab.d;
+  uint64_t nnz = 0;
+  for (int ini = 0; ini < n; ini += LINHAS_POR_BLOCO) {
+    int fim = ini + LINHAS_POR_BLOCO < n ? ini + LINHAS_POR_BLOCO : n;
+    Ponto *pontos;
+    if (formato_ler_pontos(entrada, ini, fim, &pontos) != 0) return -1;
+    for (int i = 0; i < fim - ini; i++) {
+      for (int j = 0; j < d; j++) nnz += pontos[i].features[j] != 0;
+    }
+    formato_liberar_pontos(pontos, fim - ini);
+  }
+  printf("Entradas não nulas: %llu (densidade %.4f%%)\n", (unsigned long long) nnz,
+         n > 0 && d > 0 ? 100.0 * nnz / ((double) n * d) : 0.0);
+
+  uint32_t *indices = (uint32_t*) malloc((d > 0 ? d : 1) * sizeof(uint32_t));
+  double *valores = (double*) malloc((d > 0 ? d : 1) * sizeof(double));
+  EscritorEsparso w;
+  if (!indices || !valores || esparso_escritor_abrir(&w, saida, n, d, nnz) != 0) {
+    free(indices);
+    free(valores);
+    return -1;
+  }
+
+  int ret = 0;
+  for (int ini = 0; ini < n && ret == 0; ini += LINHAS_POR_BLOCO) {
+    int fim = ini + LINHAS_POR_BLOCO < n ? ini + LINHAS_POR_BLOCO : n;
+    Ponto *pontos;
+    if (formato_ler_pontos(entrada, ini, fim, &pontos) != 0) {
+      ret = -1;
+      break;
+    }
+    for (int i = 0; i < fim - ini && ret == 0; i++) {
+      int cont = 0;
+      for (int j = 0; j < d; j++) {
+        if (pontos[i].features[j] != 0) {
+          indices[cont] = (uint32_t) j;
+          valores[cont++] = pontos[i].features[j];
+        }
+      }
+      ret = esparso_escritor_linha(&w, indices, valores, cont);
+    }
+    formato_liberar_pontos(pontos, fim - ini);
+  }
+  if (esparso_escritor_fechar(&w) != 0) ret = -1;
+  free(indices);
+  free(valores);
+  return ret;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3 && argc != 4) {
+    fprintf(stderr, "Uso: %s <entrada> <saida> [dtype]\n", argv[0]);
+    fprintf(stderr, "  entrada: dataset no formato legado ou v2\n");
+    fprintf(stderr, "  saida: arquivo a ser gerado no formato v2\n");
+    fprintf(stderr, "  dtype: float64 (padrão), float32, int8 ou esparso (CSR sem os zeros)\n");
+    fprintf(stderr, "Exemplo: %s train.bin train_f32.bin float32\n", argv[0]);
+    return 1;
+  }
+
+  int esparso = argc == 4 && strcmp(argv[3], "esparso") == 0;
+  int dtype = argc == 4 && !esparso ? dtype_de_nome(argv[3]) : DTYPE_FLOAT64;
+  if (dtype < 0) {
+    fprintf(stderr, "Erro: dtype desconhecido '%s'\n", argv[3]);
+    return 1;
+  }
+
+  ArquivoDataset entrada;
+  if (formato_abrir(argv[1], &entrada) != 0) return 1;
+
+  int n = (int) entrada.cab.n;
+  int d = (int) entrada.cab.d;
+  if (esparso) {
+    printf("Convertendo %s (%s, %s, %d pontos, %d dimensões) para o formato esparso\n",
+           argv[1], entrada.legado ? "legado" : "v2",
+           dtype_nome((DType) entrada.cab.dtype), n, d);
+    int ret = converter_esparso(&entrada, argv[2]);
+    formato_fechar(&entrada);
+    if (ret != 0) {
+      fprintf(stderr, "Falha na conversão de %s\n", argv[1]);
+      return 1;
+    }
+    printf("Arquivo '%s' gerado com sucesso!\n", argv[2]);
+    return 0;
+  }
+  printf("Convertendo %s (%s, %s, %d pontos, %d dimensões) para v2 (%s)\n",
+         argv[1], entrada.legado ? "legado" : "v2",
+         dtype_nome((DType) entrada.cab.dtype), n, d, dtype_nome((DType) dtype));
+
+  double escala = 1.0;
+  if (dtype == DTYPE_INT8) {
+    double maior;
+    if (maior_absoluto(&entrada, &maior) != 0) {
+      formato_fechar(&entrada);
+      return 1;
+    }
+    escala = maior > 0 ? maior / 127.0 : 1.0;
+    printf("Escala int8: %g\n", escala);
+  }
+
+  EscritorDataset saida;
+  if (formato_escritor_abrir(&saida, argv[2], (DType) dtype, n, d, escala,
+                             entrada.cab.offset_ids != 0,
+                             entrada.cab.offset_rotulos != 0) != 0) {
+    formato_fechar(&entrada);
+    return 1;
+  }
+
+  int ret = 0;
+  for (int ini = 0; ini < n && ret == 0; ini += LINHAS_POR_BLOCO) {
+    int fim = ini + LINHAS_POR_BLOCO < n ? ini + LINHAS_POR_BLOCO : n;
+    Ponto *pontos;
+    if (formato_ler_pontos(&entrada, ini, fim, &pontos) != 0) {
+      ret = -1;
+      break;
+    }
+    for (int i = 0; i < fim - ini && ret == 0; i++) {
+      ret = formato_escritor_linha(&saida, pontos[i].features, pontos[i].id,
+                                   pontos[i].rotulo);
+    }
+    formato_liberar_pontos(pontos, fim - ini);
+  }
+
+  if (formato_escritor_fechar(&saida) != 0) ret = -1;
+  formato_fechar(&entrada);
+
+  if (ret != 0) {
+    fprintf(stderr, "Falha na conversão de %s\n", argv[1]);
+    return 1;
+  }
+  printf("Arquivo '%s' gerado com sucesso!\n", argv[2]);
+  return 0;
+}
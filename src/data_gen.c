@@ -1,61 +1,77 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <time.h>
 
+#include "formato.h"
+
 // Função para gerar um número double aleatório no intervalo [min, max]
 double random_in_range(double min, double max) {
     return min + ((double) rand() / RAND_MAX) * (max - min);
 }
 
-// Função para gerar um dataset binário com pontos aleatórios dados pela random_in_range
-void generate_dataset(const char *filename, int points, int dimensions, double min, double max) {
+// Função para gerar um dataset binário (formato v2) com pontos aleatórios dados pela random_in_range
+void generate_dataset(const char *filename, int points, int dimensions, double min, double max,
+                      DType dtype) {
 
-    FILE *file = fopen(filename, "wb");
+    EscritorDataset w;
+    // No int8 a escala cobre o maior valor absoluto do intervalo
+    double escala = fmax(fabs(min), fabs(max)) / 127.0;
+    if (escala <= 0) escala = 1.0;
 
-    if (!file) {
-        perror("Erro ao criar arquivo");
+    if (formato_escritor_abrir(&w, filename, dtype, points, dimensions, escala, 0, 0) != 0) {
         exit(EXIT_FAILURE);
     }
 
-    fwrite(&points, sizeof(int), 1, file);
-    fwrite(&dimensions, sizeof(int), 1, file);
+    double *features = (double*) malloc(dimensions * sizeof(double));
+    if (!features) {
+        perror("Erro de alocação de memória");
+        exit(EXIT_FAILURE);
+    }
 
     for (int i = 0; i < points; i++) {
         for (int j = 0; j < dimensions; j++) {
-            double value = random_in_range(min, max);
-            fwrite(&value, sizeof(double), 1, file);
+            features[j] = random_in_range(min, max);
+        }
+        if (formato_escritor_linha(&w, features, i, -1) != 0) {
+            exit(EXIT_FAILURE);
         }
     }
 
-    fclose(file);
+    free(features);
+    if (formato_escritor_fechar(&w) != 0) {
+        exit(EXIT_FAILURE);
+    }
 }
 
-// Função para imprimir pontos do dataset
+// Função para imprimir pontos do dataset (v2 ou legado)
 void print_dataset(const char *filename, int max_print) {
 
-    FILE *file = fopen(filename, "rb");
-
-    if (!file) {
-        perror("Erro ao abrir arquivo para leitura");
+    ArquivoDataset arq;
+    if (formato_abrir(filename, &arq) != 0) {
         return;
     }
 
     printf("\n--- Conteúdo de %s ---\n", filename);
 
-    int points;
-    fread(&points, sizeof(int), 1, file);
+    int points = (int) arq.cab.n;
+    printf("Formato: %s (%s)\n", arq.legado ? "legado" : "v2", dtype_nome((DType) arq.cab.dtype));
     printf("Número de pontos: %d\n", points);
 
-    int dimensions;
-    fread(&dimensions, sizeof(int), 1, file);
+    int dimensions = (int) arq.cab.d;
     printf("Dimensões: %d\n\n", dimensions);
 
-    for (int i = 0; i < points && i < max_print; i++) {
+    int n_print = points < max_print ? points : max_print;
+    Ponto *pontos;
+    if (formato_ler_pontos(&arq, 0, n_print, &pontos) != 0) {
+        formato_fechar(&arq);
+        return;
+    }
+
+    for (int i = 0; i < n_print; i++) {
         printf("Ponto %d: ", i );
         for (int j = 0; j < dimensions; j++) {
-            double value;
-            fread(&value, sizeof(double), 1, file);
-            printf("%.2f ", value);
+            printf("%.2f ", pontos[i].features[j]);
         }
         printf("\n");
     }
@@ -64,14 +80,16 @@ void print_dataset(const char *filename, int max_print) {
         printf("--===(%d pontos no total)===--\n", points);
     }
 
-    fclose(file);
+    formato_liberar_pontos(pontos, n_print);
+    formato_fechar(&arq);
 }
 
 // Função principal para testar a geração de datasets de treino e teste e printá-los
 int main(int argc, char *argv[]) {
 
-    if (argc != 6) {
-        fprintf(stderr, "Uso: %s <N_treino> <M_teste> <D_dimensao> <min> <max>\n", argv[0]);
+    if (argc != 6 && argc != 7) {
+        fprintf(stderr, "Uso: %s <N_treino> <M_teste> <D_dimensao> <min> <max> [dtype]\n", argv[0]);
+        fprintf(stderr, "  dtype: float64 (padrão), float32 ou int8\n");
         fprintf(stderr, "Exemplo: %s 1000 200 4 0 100\n", argv[0]);
         return -1;
     }
@@ -81,14 +99,20 @@ int main(int argc, char *argv[]) {
     int D = atoi(argv[3]);       // dimensões
     double min = atof(argv[4]);   // valor mínimo
     double max = atof(argv[5]);   // valor máximo
+    int dtype = argc == 7 ? dtype_de_nome(argv[6]) : DTYPE_FLOAT64;
+
+    if (dtype < 0) {
+        fprintf(stderr, "Erro: dtype desconhecido '%s'\n", argv[6]);
+        return -1;
+    }
 
     srand(time(NULL));
 
     printf("Gerando %d pontos de treino e %d de teste (%d dimensões) no intervalo [%.2f, %.2f]\n",
            N, M, D, min, max);
 
-    generate_dataset("train.bin", N, D, min, max);
-    generate_dataset("test.bin", M, D, min, max);
+    generate_dataset("train.bin", N, D, min, max, (DType) dtype);
+    generate_dataset("test.bin", M, D, min, max, (DType) dtype);
 
     printf("\nArquivos 'train.bin' e 'test.bin' gerados com sucesso!\n");
 
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dataset.h"
+#include "formato.h"
+
+void liberar_dataset(Dataset *dataset) {
+  formato_liberar_pontos(dataset->treino, dataset->N);
+  // No self-join o conjunto de teste é o próprio treino
+  if (dataset->teste != dataset->treino) {
+    formato_liberar_pontos(dataset->teste, dataset->M);
+  }
+  dataset->treino = NULL;
+  dataset->teste = NULL;
+}
+
+int inicializar_dataset(Dataset *dataset, const char *arquivo_treino,
+                        const char *arquivo_teste, int K, int ini_treino,
+                        int fim_treino) {
+
+  dataset->K = K;
+  dataset->treino = NULL;
+  dataset->teste = NULL;
+
+  ArquivoDataset file_treino, file_teste;
+
+  if (formato_abrir(arquivo_treino, &file_treino) != 0) {
+    fprintf(stderr, "Falha ao abrir arquivo de treino: %s\n", arquivo_treino);
+    return -1;
+  }
+  if (formato_abrir(arquivo_teste, &file_teste) != 0) {
+    fprintf(stderr, "Falha ao abrir arquivo de teste: %s\n", arquivo_teste);
+    formato_fechar(&file_treino);
+    return -1;
+  }
+
+  dataset->N = (int) file_treino.cab.n;
+  dataset->M = (int) file_teste.cab.n;
+
+  // Verifica se as dimensões são compatíveis
+  if (file_treino.cab.d != file_teste.cab.d) {
+    fprintf(stderr, "Erro: Dimensões incompatíveis - treino: %u, teste: %u\n",
+            file_treino.cab.d, file_teste.cab.d);
+    formato_fechar(&file_treino);
+    formato_fechar(&file_teste);
+    return -1;
+  }
+
+  dataset->D = (int) file_treino.cab.d;
+
+  // Valida K
+  if (K <= 0 || K > dataset->N) {
+    fprintf(stderr, "Erro: K deve estar entre 1 e %d (número de pontos de treino)\n", dataset->N);
+    formato_fechar(&file_treino);
+    formato_fechar(&file_teste);
+    return -1;
+  }
+
+  // Valida a fatia de treino, se houver
+  if (ini_treino < 0) {
+    ini_treino = 0;
+    fim_treino = dataset->N;
+  } else if (fim_treino < ini_treino || fim_treino > dataset->N) {
+    fprintf(stderr, "Erro: fatia de treino [%d, %d) fora do intervalo [0, %d)\n",
+            ini_treino, fim_treino, dataset->N);
+    formato_fechar(&file_treino);
+    formato_fechar(&file_teste);
+    return -1;
+  }
+  dataset->N = fim_treino - ini_treino;
+
+  // Lê os datasets dos arquivos
+  printf("Lendo dataset de treino (%s, %s)...\n",
+         file_treino.legado ? "legado" : "v2",
+         dtype_nome((DType) file_treino.cab.dtype));
+  if (formato_ler_pontos(&file_treino, ini_treino, fim_treino, &dataset->treino) != 0) {
+    formato_fechar(&file_treino);
+    formato_fechar(&file_teste);
+    return -1;
+  }
+
+  printf("Lendo dataset de teste (%s, %s)...\n",
+         file_teste.legado ? "legado" : "v2",
+         dtype_nome((DType) file_teste.cab.dtype));
+  if (formato_ler_pontos(&file_teste, 0, dataset->M, &dataset->teste) != 0) {
+    formato_fechar(&file_treino);
+    formato_fechar(&file_teste);
+    liberar_dataset(dataset);
+    return -1;
+  }
+
+  formato_fechar(&file_treino);
+  formato_fechar(&file_teste);
+
+  printf("Datasets carregados com sucesso!\n");
+  printf("Treino: %d pontos, Teste: %d pontos, Dimensões: %d, K: %d\n",
+         dataset->N, dataset->M, dataset->D, dataset->K);
+
+  return 0;
+}
+
+int inicializar_consultas(Dataset *dataset, const char *arquivo_treino,
+                          const char *arquivo_teste, int K) {
+  ArquivoDataset file_treino, file_teste;
+
+  dataset->K = K;
+  dataset->treino = NULL;
+  dataset->teste = NULL;
+
+  // Do treino só o cabeçalho é lido, para validar K e as dimensões
+  if (formato_abrir(arquivo_treino, &file_treino) != 0) {
+    fprintf(stderr, "Falha ao abrir arquivo de treino: %s\n", arquivo_treino);
+    return -1;
+  }
+  dataset->N = (int) file_treino.cab.n;
+  dataset->D = (int) file_treino.cab.d;
+  formato_fechar(&file_treino);
+
+  if (formato_abrir(arquivo_teste, &file_teste) != 0) {
+    fprintf(stderr, "Falha ao abrir arquivo de teste: %s\n", arquivo_teste);
+    return -1;
+  }
+  dataset->M = (int) file_teste.cab.n;
+
+  if (file_teste.cab.d != (uint32_t) dataset->D) {
+    fprintf(stderr, "Erro: Dimensões incompatíveis - treino: %d, teste: %u\n",
+            dataset->D, file_teste.cab.d);
+    formato_fechar(&file_teste);
+    return -1;
+  }
+  if (K <= 0 || K > dataset->N) {
+    fprintf(stderr, "Erro: K deve estar entre 1 e %d (número de pontos de treino)\n", dataset->N);
+    formato_fechar(&file_teste);
+    return -1;
+  }
+
+  printf("Lendo dataset de teste (%s, %s)...\n",
+         file_teste.legado ? "legado" : "v2",
+         dtype_nome((DType) file_teste.cab.dtype));
+  if (formato_ler_pontos(&file_teste, 0, dataset->M, &dataset->teste) != 0) {
+    formato_fechar(&file_teste);
+    return -1;
+  }
+  formato_fechar(&file_teste);
+
+  printf("Dataset de teste carregado com sucesso!\n");
+  printf("Treino: %d pontos (não carregado), Teste: %d pontos, Dimensões: %d, K: %d\n",
+         dataset->N, dataset->M, dataset->D, dataset->K);
+  return 0;
+}
+
+int inicializar_autojuncao(Dataset *dataset, const char *arquivo_treino, int K) {
+  ArquivoDataset file_treino;
+
+  dataset->K = K;
+  dataset->treino = NULL;
+  dataset->teste = NULL;
+
+  if (formato_abrir(arquivo_treino, &file_treino) != 0) {
+    fprintf(stderr, "Falha ao abrir arquivo de treino: %s\n", arquivo_treino);
+    return -1;
+  }
+
+  dataset->N = (int) file_treino.cab.n;
+  dataset->M = dataset->N;
+  dataset->D = (int) file_treino.cab.d;
+
+  if (K <= 0 || K >= dataset->N) {
+    fprintf(stderr, "Erro: no self-join K deve estar entre 1 e %d\n", dataset->N - 1);
+    formato_fechar(&file_treino);
+    return -1;
+  }
+
+  printf("Lendo dataset de treino (%s, %s)...\n",
+         file_treino.legado ? "legado" : "v2",
+         dtype_nome((DType) file_treino.cab.dtype));
+  if (formato_ler_pontos(&file_treino, 0, dataset->N, &dataset->treino) != 0) {
+    formato_fechar(&file_treino);
+    return -1;
+  }
+  formato_fechar(&file_treino);
+  dataset->teste = dataset->treino;
+
+  printf("Dataset carregado com sucesso!\n");
+  printf("Self-join: %d pontos, Dimensões: %d, K: %d\n", dataset->N, dataset->D,
+         dataset->K);
+  return 0;
+}
+
+int inicializar_heaps(Heap *heaps, int M, int K) {
+  for (int i = 0; i < M; i++) {
+    heap_init(&heaps[i], K);
+  }
+  return 0;
+}
+
+void liberar_heaps(Heap *heaps, int M) {
+  for (int i = 0; i < M; i++) {
+    heap_libera(&heaps[i]);
+  }
+}
+
+void salvar_resultados(Heap *heaps, int M, int K, const char *filename) {
+  FILE *file = fopen(filename, "w");
+  if (!file) {
+    fprintf(stderr, "Erro ao criar arquivo de saída %s\n", filename);
+    return;
+  }
+
+  fprintf(file, "Resultados do KNN (K=%d)\n", K);
+  fprintf(file, "==============================\n\n");
+
+  for (int i = 0; i < M; i++) {
+    fprintf(file, "Ponto de teste %d:\n", i);
+    fprintf(file, "K-vizinhos mais próximos:\n");
+
+    for (int j = 0; j < heaps[i].n_elem; j++) {
+      fprintf(file, "  ID: %d, Distância: %.6f\n", heaps[i].data[j].id,
+              heaps[i].data[j].dist);
+    }
+    fprintf(file, "\n");
+  }
+
+  fclose(file);
+  printf("Resultados salvos em %s\n", filename);
+}
@@ -0,0 +1,77 @@
+/**
+ * @file dataset.h
+ * @brief Carga dos datasets de treino e teste, heaps de resultados e saída texto.
+ */
+
+#ifndef DATASET_H
+#define DATASET_H
+
+#include "heap.h"
+#include "knn.h"
+
+/**
+ * @brief Libera a memória do dataset
+ *
+ * @param dataset Ponteiro para a estrutura Dataset
+ */
+void liberar_dataset(Dataset *dataset);
+
+/**
+ * @brief Inicializa o dataset com dados de treino e teste
+ *
+ * @details Os arquivos podem estar tanto no formato v2 quanto no formato
+ * legado; o formato é detectado automaticamente (ver formato.h). Quando
+ * `ini_treino >= 0`, apenas as linhas de treino `[ini_treino, fim_treino)`
+ * são carregadas, preservando seus ids globais.
+ */
+int inicializar_dataset(Dataset *dataset, const char *arquivo_treino,
+                        const char *arquivo_teste, int K, int ini_treino,
+                        int fim_treino);
+
+/**
+ * @brief Inicializa só as consultas, deixando o treino fora da memória
+ *
+ * @details Do treino é lido apenas o cabeçalho (N e D); `dataset->treino`
+ * fica NULL. É o caminho da busca pela PQ, em que o treino é carregado,
+ * codificado e descartado pelo contexto da libknn.
+ */
+int inicializar_consultas(Dataset *dataset, const char *arquivo_treino,
+                          const char *arquivo_teste, int K);
+
+/**
+ * @brief Inicializa o dataset para o self-join: o teste é o próprio treino
+ *
+ * @details Como o próprio ponto é excluído dos vizinhos, K pode ser no máximo
+ * N - 1.
+ */
+int inicializar_autojuncao(Dataset *dataset, const char *arquivo_treino, int K);
+
+/**
+ * @brief Inicializa as heaps para cada ponto de teste
+ *
+ * @param heaps Array de heaps
+ * @param M Número de pontos de teste (número de heaps)
+ * @param K Capacidade de cada heap
+ * @return 0 em caso de sucesso, -1 em caso de erro
+ */
+int inicializar_heaps(Heap *heaps, int M, int K);
+
+/**
+ * @brief Libera a memória das heaps
+ *
+ * @param heaps Array de heaps
+ * @param M Número de heaps
+ */
+void liberar_heaps(Heap *heaps, int M);
+
+/**
+ * @brief Salva os resultados em um arquivo
+ *
+ * @param heaps Array de heaps com os resultados
+ * @param M Número de pontos de teste
+ * @param K Número de vizinhos mais próximos
+ * @param filename Nome do arquivo de saída
+ */
+void salvar_resultados(Heap *heaps, int M, int K, const char *filename);
+
+#endif // !DATASET_H
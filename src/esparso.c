@@ -0,0 +1,460 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "esparso.h"
+#include "pool.h"
+#include "trace.h"
+
+// Folga relativa no corte pela pior distância da heap (ver motor.c)
+#define FOLGA_CORTE (1 + 1e-12)
+// Consultas esparsas com menos de 1 / RAZAO_INTERCALACAO das entradas de uma
+// linha média do treino usam o kernel esparso-esparso (ver esparso_buscar());
+// abaixo disso a busca binária custa menos que o acesso aleatório ao rascunho
+#define RAZAO_INTERCALACAO 32
+// Razão de tamanhos a partir da qual o produto esparso-esparso troca a
+// intercalação pela busca binária
+#define RAZAO_BUSCA 8
+
+int esparso_detectar(const char *arquivo) {
+  FILE *f = fopen(arquivo, "rb");
+  if (!f) {
+    fprintf(stderr, "Falha ao abrir dataset: %s\n", arquivo);
+    return -1;
+  }
+  char magico[4];
+  int esparso = fread(magico, 1, 4, f) == 4 && memcmp(magico, ESPARSO_MAGICO, 4) == 0;
+  fclose(f);
+  return esparso;
+}
+
+// Confere o CSR lido: offsets crescentes e colunas válidas e ordenadas
+static int validar(const MatrizEsparsa *m) {
+  if (m->indptr[0] != 0 || m->indptr[m->n] != m->nnz) return -1;
+  for (int i = 0; i < m->n; i++) {
+    if (m->indptr[i + 1] < m->indptr[i]) return -1;
+    for (int64_t k = m->indptr[i]; k < m->indptr[i + 1]; k++) {
+      if (m->indices[k] >= (uint32_t) m->d) return -1;
+      if (k > m->indptr[i] && m->indices[k] <= m->indices[k - 1]) return -1;
+    }
+  }
+  return 0;
+}
+
+static int ler_secao(FILE *f, uint64_t offset, void *buf, size_t tamanho, size_t n) {
+  if (n == 0) return 0;
+  if (fseeko(f, (off_t) offset, SEEK_SET) != 0) return -1;
+  return fread(buf, tamanho, n, f) == n ? 0 : -1;
+}
+
+int esparso_ler(const char *arquivo, MatrizEsparsa *m) {
+  memset(m, 0, sizeof(*m));
+  FILE *f = fopen(arquivo, "rb");
+  if (!f) {
+    fprintf(stderr, "Falha ao abrir dataset: %s\n", arquivo);
+    return -1;
+  }
+
+  CabecalhoEsparso cab;
+  if (fread(&cab, sizeof(cab), 1, f) != 1 || memcmp(cab.magico, ESPARSO_MAGICO, 4) != 0) {
+    fprintf(stderr, "Erro: %s não é um dataset esparso\n", arquivo);
+    fclose(f);
+    return -1;
+  }
+  if (cab.versao != ESPARSO_VERSAO) {
+    fprintf(stderr, "Erro: versão %u do formato esparso não suportada (%s)\n",
+            cab.versao, arquivo);
+    fclose(f);
+    return -1;
+  }
+  // Os pontos e as dimensões são indexados com int, e as seções precisam
+  // caber em size_t
+  if (cab.n > INT_MAX || cab.d == 0 || cab.d > INT_MAX ||
+      cab.nnz > (uint64_t) (SIZE_MAX / sizeof(double))) {
+    fprintf(stderr, "Erro: cabeçalho esparso inválido em %s (n=%llu, d=%u, nnz=%llu)\n",
+            arquivo, (unsigned long long) cab.n, cab.d, (unsigned long long) cab.nnz);
+    fclose(f);
+    return -1;
+  }
+
+  m->n = (int) cab.n;
+  m->d = (int) cab.d;
+  m->nnz = (int64_t) cab.nnz;
+  m->indptr = (int64_t*) malloc(((size_t) cab.n + 1) * sizeof(int64_t));
+  m->indices = (uint32_t*) malloc((cab.nnz > 0 ? (size_t) cab.nnz : 1) * sizeof(uint32_t));
+  m->valores = (double*) malloc((cab.nnz > 0 ? (size_t) cab.nnz : 1) * sizeof(double));
+  m->normas2 = (double*) malloc((cab.n > 0 ? cab.n : 1) * sizeof(double));
+  if (!m->indptr || !m->indices || !m->valores || !m->normas2) {
+    fprintf(stderr, "Erro de alocação de memória para o dataset esparso\n");
+    fclose(f);
+    esparso_libera(m);
+    return -1;
+  }
+
+  int ret = ler_secao(f, cab.offset_indptr, m->indptr, sizeof(int64_t), cab.n + 1);
+  if (ret == 0) ret = ler_secao(f, cab.offset_indices, m->indices, sizeof(uint32_t), cab.nnz);
+  if (ret == 0) ret = ler_secao(f, cab.offset_valores, m->valores, sizeof(double), cab.nnz);
+  fclose(f);
+  if (ret != 0) {
+    fprintf(stderr, "Erro ao ler as seções de %s\n", arquivo);
+    esparso_libera(m);
+    return -1;
+  }
+  if (validar(m) != 0) {
+    fprintf(stderr, "Erro: CSR inválido em %s\n", arquivo);
+    esparso_libera(m);
+    return -1;
+  }
+
+  for (int i = 0; i < m->n; i++) {
+    double soma = 0;
+    for (int64_t k = m->indptr[i]; k < m->indptr[i + 1]; k++) {
+      soma += m->valores[k] * m->valores[k];
+    }
+    m->normas2[i] = soma;
+  }
+  return 0;
+}
+
+void esparso_libera(MatrizEsparsa *m) {
+  free(m->indptr);
+  free(m->indices);
+  free(m->valores);
+  free(m->normas2);
+  m->indptr = NULL;
+  m->indices = NULL;
+  m->valores = NULL;
+  m->normas2 = NULL;
+}
+
+static FILE *abrir_em(const char *arquivo, uint64_t offset) {
+  FILE *f = fopen(arquivo, "r+b");
+  if (f && fseeko(f, (off_t) offset, SEEK_SET) != 0) {
+    fclose(f);
+    return NULL;
+  }
+  return f;
+}
+
+int esparso_escritor_abrir(EscritorEsparso *w, const char *arquivo, uint64_t n,
+                           uint32_t d, uint64_t nnz) {
+  memset(w, 0, sizeof(*w));
+  memcpy(w->cab.magico, ESPARSO_MAGICO, 4);
+  w->cab.versao = ESPARSO_VERSAO;
+  w->cab.d = d;
+  w->cab.n = n;
+  w->cab.nnz = nnz;
+  w->cab.offset_indptr = sizeof(CabecalhoEsparso);
+  w->cab.offset_indices = w->cab.offset_indptr + (n + 1) * sizeof(int64_t);
+  // Os valores começam alinhados a 8 bytes
+  w->cab.offset_valores = (w->cab.offset_indices + nnz * sizeof(uint32_t) + 7) & ~7ULL;
+
+  int64_t zero = 0;
+  w->indptr = fopen(arquivo, "wb");
+  if (!w->indptr || fwrite(&w->cab, sizeof(w->cab), 1, w->indptr) != 1 ||
+      fwrite(&zero, sizeof(zero), 1, w->indptr) != 1 || fflush(w->indptr) != 0) {
+    fprintf(stderr, "Erro ao criar arquivo esparso: %s\n", arquivo);
+    if (w->indptr) fclose(w->indptr);
+    return -1;
+  }
+  w->indices = abrir_em(arquivo, w->cab.offset_indices);
+  w->valores = abrir_em(arquivo, w->cab.offset_valores);
+  if (!w->indices || !w->valores) {
+    fprintf(stderr, "Erro ao criar arquivo esparso: %s\n", arquivo);
+    fclose(w->indptr);
+    if (w->indices) fclose(w->indices);
+    if (w->valores) fclose(w->valores);
+    return -1;
+  }
+  return 0;
+}
+
+int esparso_escritor_linha(EscritorEsparso *w, const uint32_t *indices,
+                           const double *valores, int cont) {
+  if (w->linhas >= w->cab.n || (uint64_t) (w->escritos + cont) > w->cab.nnz) {
+    fprintf(stderr, "Erro: linhas ou entradas além do declarado no arquivo esparso\n");
+    return -1;
+  }
+  w->escritos += cont;
+  w->linhas++;
+  if (fwrite(indices, sizeof(uint32_t), cont, w->indices) != (size_t) cont ||
+      fwrite(valores, sizeof(double), cont, w->valores) != (size_t) cont ||
+      fwrite(&w->escritos, sizeof(int64_t), 1, w->indptr) != 1) {
+    fprintf(stderr, "Erro ao gravar linha do arquivo esparso\n");
+    return -1;
+  }
+  return 0;
+}
+
+int esparso_escritor_fechar(EscritorEsparso *w) {
+  int ret = 0;
+  if (w->linhas != w->cab.n || (uint64_t) w->escritos != w->cab.nnz) {
+    fprintf(stderr, "Erro: arquivo esparso incompleto (%llu de %llu linhas)\n",
+            (unsigned long long) w->linhas, (unsigned long long) w->cab.n);
+    ret = -1;
+  }
+  if (fclose(w->indices) != 0) ret = -1;
+  if (fclose(w->valores) != 0) ret = -1;
+  if (fclose(w->indptr) != 0) ret = -1;
+  return ret;
+}
+
+// Primeira posição de [ini, fim) com coluna >= `coluna`
+static int64_t buscar_coluna(const uint32_t *indices, int64_t ini, int64_t fim,
+                             uint32_t coluna) {
+  while (ini < fim) {
+    int64_t meio = ini + (fim - ini) / 2;
+    if (indices[meio] < coluna) {
+      ini = meio + 1;
+    } else {
+      fim = meio;
+    }
+  }
+  return ini;
+}
+
+double esparso_produto(const MatrizEsparsa *a, int i, const MatrizEsparsa *b, int j) {
+  int64_t p = a->indptr[i], p_fim = a->indptr[i + 1];
+  int64_t q = b->indptr[j], q_fim = b->indptr[j + 1];
+  double soma = 0;
+
+  // Listas de tamanhos muito diferentes: cada coluna da curta é buscada na longa
+  if ((p_fim - p) * RAZAO_BUSCA < q_fim - q) {
+    for (; p < p_fim && q < q_fim; p++) {
+      q = buscar_coluna(b->indices, q, q_fim, a->indices[p]);
+      if (q < q_fim && b->indices[q] == a->indices[p]) soma += a->valores[p] * b->valores[q++];
+    }
+    return soma;
+  }
+  if ((q_fim - q) * RAZAO_BUSCA < p_fim - p) return esparso_produto(b, j, a, i);
+
+  while (p < p_fim && q < q_fim) {
+    if (a->indices[p] == b->indices[q]) {
+      soma += a->valores[p++] * b->valores[q++];
+    } else if (a->indices[p] < b->indices[q]) {
+      p++;
+    } else {
+      q++;
+    }
+  }
+  return soma;
+}
+
+double esparso_produto_denso(const MatrizEsparsa *a, int i, const double *x) {
+  double soma = 0;
+  for (int64_t k = a->indptr[i]; k < a->indptr[i + 1]; k++) {
+    soma += a->valores[k] * x[a->indices[k]];
+  }
+  return soma;
+}
+
+double esparso_distancia2(const MatrizEsparsa *a, int i, const MatrizEsparsa *b, int j) {
+  double d2 = a->normas2[i] + b->normas2[j] - 2 * esparso_produto(a, i, b, j);
+  // O cancelamento pode deixar um resíduo negativo para pontos quase iguais
+  return d2 > 0 ? d2 : 0;
+}
+
+double esparso_distancia2_denso(const MatrizEsparsa *a, int i, const double *x,
+                                double norma2_x) {
+  double d2 = a->normas2[i] + norma2_x - 2 * esparso_produto_denso(a, i, x);
+  return d2 > 0 ? d2 : 0;
+}
+
+/**
+ * @brief Estado compartilhado pelas tarefas da busca esparsa.
+ */
+typedef struct {
+  const MatrizEsparsa *treino;
+  const MatrizEsparsa *teste;  /* consultas esparsas (ou NULL) */
+  const Ponto *teste_denso;    /* consultas densas (ou NULL) */
+  const double *normas2_teste; /* normas das consultas */
+  int M;
+  MetricaEsparsa metrica;
+  double media_nnz;            /* entradas não nulas por linha de treino */
+  Heap *heaps;                 /* heaps finais */
+  Heap *locais;                /* M heaps por thread (as finais se houver uma só) */
+  int *cortes;                 /* faixas de treino de cada thread */
+  int erro;
+  pthread_mutex_t mutex;       /* protege `erro` */
+} BuscaEsparsa;
+
+// Compara a consulta `q` com as linhas [ini, fim) do treino; com `x` nulo a
+// consulta é esparsa e usa o kernel esparso-esparso
+static void varrer_consulta(const BuscaEsparsa *b, int q, const double *x, int ini, int fim,
+                            Heap *h) {
+  const MatrizEsparsa *treino = b->treino;
+  for (int i = ini; i < fim; i++) {
+    if (b->metrica == ESPARSO_PRODUTO) {
+      // A heap guarda os menores valores: o negativo dá os maiores produtos
+      double valor = -(x ? esparso_produto_denso(treino, i, x)
+                         : esparso_produto(treino, i, b->teste, q));
+      if (h->n_elem < h->length || valor <= h->data[0].dist) {
+        heap_inserir(h, valor, i);
+      }
+    } else {
+      double d2 = x ? esparso_distancia2_denso(treino, i, x, b->normas2_teste[q])
+                    : esparso_distancia2(treino, i, b->teste, q);
+      if (h->n_elem < h->length ||
+          d2 <= h->data[0].dist * h->data[0].dist * FOLGA_CORTE) {
+        heap_inserir(h, sqrt(d2), i);
+      }
+    }
+  }
+}
+
+static void marcar_erro(BuscaEsparsa *b) {
+  pthread_mutex_lock(&b->mutex);
+  b->erro = 1;
+  pthread_mutex_unlock(&b->mutex);
+}
+
+static void tarefa_varrer(int indice, int total, void *arg) {
+  (void) total;
+  BuscaEsparsa *b = (BuscaEsparsa*) arg;
+  const MatrizEsparsa *teste = b->teste;
+  Heap *heaps = b->locais + (size_t) indice * b->M;
+  int ini = b->cortes[indice], fim = b->cortes[indice + 1];
+
+  // Rascunho denso para espalhar as consultas esparsas, alocado só se alguma
+  // consulta tiver entradas demais para o kernel esparso-esparso
+  double *denso = NULL;
+
+  trace_inicio_faixa("fatia", ini, fim);
+  for (int q = 0; q < b->M; q++) {
+    if (!teste) {
+      varrer_consulta(b, q, b->teste_denso[q].features, ini, fim, &heaps[q]);
+      continue;
+    }
+    int64_t nnz_q = teste->indptr[q + 1] - teste->indptr[q];
+    if ((double) nnz_q * RAZAO_INTERCALACAO < b->media_nnz) {
+      varrer_consulta(b, q, NULL, ini, fim, &heaps[q]);
+      continue;
+    }
+
+    if (!denso && !(denso = (double*) calloc(teste->d, sizeof(double)))) {
+      marcar_erro(b);
+      break;
+    }
+    for (int64_t k = teste->indptr[q]; k < teste->indptr[q + 1]; k++) {
+      denso[teste->indices[k]] = teste->valores[k];
+    }
+    varrer_consulta(b, q, denso, ini, fim, &heaps[q]);
+    for (int64_t k = teste->indptr[q]; k < teste->indptr[q + 1]; k++) {
+      denso[teste->indices[k]] = 0;
+    }
+  }
+  trace_fim("fatia");
+  free(denso);
+}
+
+static void tarefa_combinar(int indice, int total, void *arg) {
+  BuscaEsparsa *b = (BuscaEsparsa*) arg;
+  int q_ini = (int) ((long) b->M * indice / total);
+  int q_fim = (int) ((long) b->M * (indice + 1) / total);
+
+  trace_inicio_faixa("combinacao", q_ini, q_fim);
+  for (int q = q_ini; q < q_fim; q++) {
+    for (int t = 0; t < total; t++) {
+      const Heap *local = &b->locais[(size_t) t * b->M + q];
+      for (int j = 0; j < local->n_elem; j++) {
+        heap_inserir(&b->heaps[q], local->data[j].dist, local->data[j].id);
+      }
+    }
+  }
+  trace_fim("combinacao");
+}
+
+// Divide o treino em faixas contíguas com o mesmo número de entradas não nulas
+static void dividir_por_nnz(const MatrizEsparsa *m, int partes, int *cortes) {
+  cortes[0] = 0;
+  for (int t = 1; t < partes; t++) {
+    int64_t alvo = m->nnz * t / partes;
+    // Primeira linha cujo início alcança o alvo
+    int ini = cortes[t - 1], fim = m->n;
+    while (ini < fim) {
+      int meio = ini + (fim - ini) / 2;
+      if (m->indptr[meio] < alvo) {
+        ini = meio + 1;
+      } else {
+        fim = meio;
+      }
+    }
+    cortes[t] = ini;
+  }
+  cortes[partes] = m->n;
+}
+
+int esparso_buscar(const MatrizEsparsa *treino, const MatrizEsparsa *teste,
+                   const Ponto *teste_denso, int M, MetricaEsparsa metrica, Heap *heaps,
+                   int num_threads) {
+  if ((teste == NULL) == (teste_denso == NULL)) {
+    fprintf(stderr, "Erro: a busca esparsa precisa de consultas esparsas ou densas\n");
+    return -1;
+  }
+  if (teste && teste->d != treino->d) {
+    fprintf(stderr, "Erro: Dimensões incompatíveis - treino: %d, teste: %d\n",
+            treino->d, teste->d);
+    return -1;
+  }
+
+  Pool pool;
+  if (pool_criar(&pool, num_threads) != 0) return -1;
+
+  BuscaEsparsa b = {treino, teste, teste_denso, NULL, M, metrica,
+                    treino->n > 0 ? (double) treino->nnz / treino->n : 0,
+                    heaps, heaps, NULL, 0, PTHREAD_MUTEX_INITIALIZER};
+  double *normas2 = (double*) malloc((M > 0 ? M : 1) * sizeof(double));
+  b.cortes = (int*) malloc((num_threads + 1) * sizeof(int));
+  if (num_threads > 1) {
+    b.locais = (Heap*) malloc((size_t) num_threads * M * sizeof(Heap));
+  }
+  if (!normas2 || !b.cortes || !b.locais) {
+    fprintf(stderr, "Erro de alocação de memória para a busca esparsa\n");
+    free(normas2);
+    free(b.cortes);
+    if (b.locais != heaps) free(b.locais);
+    pool_destruir(&pool);
+    return -1;
+  }
+
+  for (int q = 0; q < M; q++) {
+    if (teste) {
+      normas2[q] = teste->normas2[q];
+    } else {
+      double soma = 0;
+      for (int j = 0; j < treino->d; j++) {
+        soma += teste_denso[q].features[j] * teste_denso[q].features[j];
+      }
+      normas2[q] = soma;
+    }
+  }
+  b.normas2_teste = normas2;
+  dividir_por_nnz(treino, num_threads, b.cortes);
+
+  int K = M > 0 ? heaps[0].length : 0;
+  if (b.locais != heaps) {
+    for (size_t i = 0; i < (size_t) num_threads * M; i++) heap_init(&b.locais[i], K);
+  }
+
+  pool_executar(&pool, tarefa_varrer, &b);
+  if (b.locais != heaps) {
+    if (!b.erro) pool_executar(&pool, tarefa_combinar, &b);
+    for (size_t i = 0; i < (size_t) num_threads * M; i++) heap_libera(&b.locais[i]);
+    free(b.locais);
+  }
+  pool_destruir(&pool);
+
+  free(normas2);
+  free(b.cortes);
+  pthread_mutex_destroy(&b.mutex);
+  if (b.erro) {
+    fprintf(stderr, "Erro de alocação de memória na busca esparsa\n");
+    return -1;
+  }
+  return 0;
+}
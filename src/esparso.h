@@ -0,0 +1,194 @@
+/**
+ * @file esparso.h
+ * @brief Datasets esparsos (CSR) e busca KNN com kernels esparsos.
+ *
+ * Para features de alta dimensão quase todas nulas (texto, TF-IDF), guardar
+ * cada ponto como um vetor denso de `double` desperdiça memória e cálculo.
+ * Um dataset esparso guarda só as entradas não nulas, no formato CSR: as
+ * entradas da linha `i` ocupam as posições `indptr[i] .. indptr[i + 1]` de
+ * `indices` (colunas, em ordem crescente) e `valores`.
+ *
+ * O arquivo tem um cabeçalho fixo de 64 bytes seguido das três seções:
+ *
+ * | campo             | tipo       | descrição                              |
+ * |-------------------|------------|----------------------------------------|
+ * | `magico`          | `char[4]`  | sempre `"KNNS"`                        |
+ * | `versao`          | `uint16_t` | versão do formato (1)                  |
+ * | `reservado`       | `uint16_t` | sempre zero                            |
+ * | `d`               | `uint32_t` | número de dimensões                    |
+ * | `reservado2`      | `uint32_t` | sempre zero                            |
+ * | `n`               | `uint64_t` | número de pontos                       |
+ * | `nnz`             | `uint64_t` | número de entradas não nulas           |
+ * | `offset_indptr`   | `uint64_t` | `n + 1` offsets `int64_t`              |
+ * | `offset_indices`  | `uint64_t` | `nnz` colunas `uint32_t`               |
+ * | `offset_valores`  | `uint64_t` | `nnz` valores `double`                 |
+ *
+ * As distâncias usam as normas pré-calculadas de cada linha:
+ * `|a - b|^2 = |a|^2 + |b|^2 - 2 <a, b>`, de modo que só o produto interno
+ * depende das entradas não nulas.
+ */
+
+#ifndef ESPARSO_H
+#define ESPARSO_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "heap.h"
+#include "knn.h"
+
+#define ESPARSO_MAGICO "KNNS" /**< Número mágico dos datasets esparsos. */
+#define ESPARSO_VERSAO 1      /**< Versão atual do formato esparso. */
+
+/**
+ * @brief Cabeçalho fixo de 64 bytes do formato esparso.
+ */
+typedef struct {
+  char magico[4];          /**< `"KNNS"`. */
+  uint16_t versao;         /**< Versão do formato. */
+  uint16_t reservado;      /**< Sempre zero. */
+  uint32_t d;              /**< Número de dimensões. */
+  uint32_t reservado2;     /**< Sempre zero. */
+  uint64_t n;              /**< Número de pontos. */
+  uint64_t nnz;            /**< Número de entradas não nulas. */
+  uint64_t offset_indptr;  /**< Offset da seção `indptr`. */
+  uint64_t offset_indices; /**< Offset da seção `indices`. */
+  uint64_t offset_valores; /**< Offset da seção `valores`. */
+} CabecalhoEsparso;
+
+/**
+ * @brief Métrica da busca esparsa.
+ */
+typedef enum {
+  ESPARSO_EUCLIDIANA, /**< Distância euclidiana; a heap guarda a distância. */
+  ESPARSO_PRODUTO     /**< Maior produto interno; a heap guarda o produto com sinal trocado. */
+} MetricaEsparsa;
+
+/**
+ * @brief Dataset esparso em memória; os ids dos pontos são `0..n-1`.
+ */
+typedef struct {
+  int n;             /**< Número de pontos. */
+  int d;             /**< Número de dimensões. */
+  int64_t nnz;       /**< Número de entradas não nulas. */
+  int64_t *indptr;   /**< `n + 1` offsets de linha. */
+  uint32_t *indices; /**< Colunas, crescentes dentro de cada linha. */
+  double *valores;   /**< Valores das entradas. */
+  double *normas2;   /**< Norma ao quadrado de cada linha. */
+} MatrizEsparsa;
+
+/**
+ * @brief Escritor de arquivos esparsos, uma linha por vez.
+ *
+ * @details Como as seções têm tamanho conhecido de antemão (`n` e `nnz`),
+ * cada uma é gravada sequencialmente por um handle próprio do arquivo.
+ */
+typedef struct {
+  FILE *indptr;      /**< Posicionado na seção `indptr`. */
+  FILE *indices;     /**< Posicionado na seção `indices`. */
+  FILE *valores;     /**< Posicionado na seção `valores`. */
+  CabecalhoEsparso cab; /**< Cabeçalho gravado na abertura. */
+  uint64_t linhas;   /**< Linhas já gravadas. */
+  int64_t escritos;  /**< Entradas já gravadas. */
+} EscritorEsparso;
+
+/**
+ * @brief Verifica se um arquivo está no formato esparso.
+ *
+ * @return 1 se estiver, 0 se não estiver, -1 se não puder ser lido.
+ */
+int esparso_detectar(const char *arquivo);
+
+/**
+ * @brief Lê um dataset esparso inteiro e calcula as normas das linhas.
+ *
+ * @details Rejeita cabeçalhos com `n > INT_MAX`, `d` nulo ou maior que
+ * `INT_MAX` ou `nnz` grande demais para a memória, e arquivos com `indptr`
+ * decrescente, colunas fora de `[0, d)` ou colunas repetidas ou fora de
+ * ordem em uma linha.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int esparso_ler(const char *arquivo, MatrizEsparsa *m);
+
+/**
+ * @brief Libera a memória de um dataset esparso.
+ */
+void esparso_libera(MatrizEsparsa *m);
+
+/**
+ * @brief Cria um arquivo esparso de `n` linhas e `nnz` entradas.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int esparso_escritor_abrir(EscritorEsparso *w, const char *arquivo, uint64_t n,
+                           uint32_t d, uint64_t nnz);
+
+/**
+ * @brief Grava a próxima linha, com `cont` entradas em colunas crescentes.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int esparso_escritor_linha(EscritorEsparso *w, const uint32_t *indices,
+                           const double *valores, int cont);
+
+/**
+ * @brief Fecha o arquivo, conferindo se todas as linhas e entradas foram gravadas.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int esparso_escritor_fechar(EscritorEsparso *w);
+
+/**
+ * @brief Produto interno entre as linhas `i` de `a` e `j` de `b` (esparso-esparso).
+ *
+ * @details Intercala as duas listas de colunas, em `O(nnz_i + nnz_j)`; se
+ * uma for muito mais curta, busca cada coluna dela na outra por busca
+ * binária, em `O(nnz_curta log nnz_longa)`.
+ */
+double esparso_produto(const MatrizEsparsa *a, int i, const MatrizEsparsa *b, int j);
+
+/**
+ * @brief Produto interno entre a linha `i` de `a` e um vetor denso `x` (esparso-denso).
+ */
+double esparso_produto_denso(const MatrizEsparsa *a, int i, const double *x);
+
+/**
+ * @brief Distância euclidiana ao quadrado entre linhas de dois datasets esparsos.
+ */
+double esparso_distancia2(const MatrizEsparsa *a, int i, const MatrizEsparsa *b, int j);
+
+/**
+ * @brief Distância euclidiana ao quadrado entre uma linha esparsa e um vetor denso.
+ *
+ * @param norma2_x Norma ao quadrado de `x`.
+ */
+double esparso_distancia2_denso(const MatrizEsparsa *a, int i, const double *x,
+                                double norma2_x);
+
+/**
+ * @brief Busca os K vizinhos de cada consulta em um treino esparso.
+ *
+ * @details As consultas podem ser esparsas (`teste`) ou densas
+ * (`teste_denso`, com `treino->d` dimensões); exatamente um dos dois deve
+ * ser não nulo. O treino é dividido entre as threads em faixas com o mesmo
+ * número de entradas não nulas, e não de pontos, para equilibrar a carga.
+ *
+ * Uma consulta esparsa com muito menos entradas que uma linha média do treino
+ * é comparada pelo kernel esparso-esparso (esparso_produto()), que busca cada
+ * coluna da consulta na linha de treino sem tocar um vetor de `d` posições.
+ * As demais são espalhadas em um vetor denso de rascunho, de modo que cada
+ * par custa só as entradas não nulas da linha de treino (kernel
+ * esparso-denso). Os resultados de cada thread ficam em heaps
+ * próprias, combinadas ao final.
+ *
+ * @param metrica Com ::ESPARSO_PRODUTO, os K vizinhos são os de maior
+ *        produto interno, e a heap guarda `-<q, t>` no lugar da distância.
+ * @param heaps Vetor de `M` heaps vazias com capacidade K.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int esparso_buscar(const MatrizEsparsa *treino, const MatrizEsparsa *teste,
+                   const Ponto *teste_denso, int M, MetricaEsparsa metrica, Heap *heaps,
+                   int num_threads);
+
+#endif // !ESPARSO_H
@@ -0,0 +1,445 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "formato.h"
+
+#define FNV_PRIMO 0x100000001b3ULL
+
+// Arredonda `x` para cima até o próximo múltiplo de `alinhamento`
+static uint64_t alinhar(uint64_t x, uint64_t alinhamento) {
+  return (x + alinhamento - 1) / alinhamento * alinhamento;
+}
+
+const char *dtype_nome(DType dtype) {
+  switch (dtype) {
+  case DTYPE_FLOAT64: return "float64";
+  case DTYPE_FLOAT32: return "float32";
+  case DTYPE_INT8: return "int8";
+  }
+  return "desconhecido";
+}
+
+int dtype_de_nome(const char *nome) {
+  if (strcmp(nome, "float64") == 0) return DTYPE_FLOAT64;
+  if (strcmp(nome, "float32") == 0) return DTYPE_FLOAT32;
+  if (strcmp(nome, "int8") == 0) return DTYPE_INT8;
+  return -1;
+}
+
+int dtype_tamanho(DType dtype) {
+  switch (dtype) {
+  case DTYPE_FLOAT64: return sizeof(double);
+  case DTYPE_FLOAT32: return sizeof(float);
+  case DTYPE_INT8: return sizeof(int8_t);
+  }
+  return 0;
+}
+
+uint64_t formato_checksum(uint64_t h, const void *buf, size_t bytes) {
+  const unsigned char *p = (const unsigned char*) buf;
+  size_t i = 0;
+  for (; i + 8 <= bytes; i += 8) {
+    uint64_t palavra;
+    memcpy(&palavra, p + i, 8);
+    h ^= palavra;
+    h *= FNV_PRIMO;
+  }
+  for (; i < bytes; i++) {
+    h ^= p[i];
+    h *= FNV_PRIMO;
+  }
+  return h;
+}
+
+// Preenche o cabeçalho equivalente a um arquivo no formato legado
+static int abrir_legado(ArquivoDataset *arq, const char *filename) {
+  int n, d;
+  if (fseeko(arq->file, 0, SEEK_SET) != 0 ||
+      fread(&n, sizeof(int), 1, arq->file) != 1 ||
+      fread(&d, sizeof(int), 1, arq->file) != 1) {
+    fprintf(stderr, "Erro na leitura dos metadados de %s\n", filename);
+    return -1;
+  }
+  if (fseeko(arq->file, 0, SEEK_END) != 0) {
+    fprintf(stderr, "Erro ao obter o tamanho de %s\n", filename);
+    return -1;
+  }
+  off_t tamanho = ftello(arq->file);
+  if (n < 0 || d <= 0 ||
+      (uint64_t) tamanho != 2 * sizeof(int) + (uint64_t) n * d * sizeof(double)) {
+    fprintf(stderr, "Erro: %s não está no formato v2 nem no formato legado\n",
+            filename);
+    return -1;
+  }
+
+  memset(&arq->cab, 0, sizeof(arq->cab));
+  memcpy(arq->cab.magico, FORMATO_MAGICO, 4);
+  arq->cab.versao = 1;
+  arq->cab.dtype = DTYPE_FLOAT64;
+  arq->cab.n = n;
+  arq->cab.d = d;
+  arq->cab.passo = d * sizeof(double);
+  arq->cab.offset_dados = 2 * sizeof(int);
+  arq->cab.escala = 1.0;
+  arq->legado = 1;
+  return 0;
+}
+
+int formato_abrir(const char *filename, ArquivoDataset *arq) {
+  memset(arq, 0, sizeof(*arq));
+  arq->file = fopen(filename, "rb");
+  if (!arq->file) {
+    fprintf(stderr, "Erro ao abrir arquivo: %s\n", filename);
+    return -1;
+  }
+
+  size_t lidos = fread(&arq->cab, 1, sizeof(arq->cab), arq->file);
+  if (lidos < 4 || memcmp(arq->cab.magico, FORMATO_MAGICO, 4) != 0) {
+    if (abrir_legado(arq, filename) != 0) {
+      formato_fechar(arq);
+      return -1;
+    }
+    return 0;
+  }
+
+  CabecalhoV2 *c = &arq->cab;
+  if (lidos != sizeof(*c)) {
+    fprintf(stderr, "Erro: cabeçalho truncado em %s\n", filename);
+    formato_fechar(arq);
+    return -1;
+  }
+  if (c->versao != FORMATO_VERSAO) {
+    fprintf(stderr, "Erro: versão %u do formato não suportada em %s\n",
+            (unsigned) c->versao, filename);
+    formato_fechar(arq);
+    return -1;
+  }
+  // Em 64 bits: d * tamanho pode passar de 2^32 e dar a volta
+  if (c->dtype > DTYPE_INT8 || c->d == 0 || c->d > INT_MAX || c->n > INT32_MAX ||
+      (uint64_t) c->d * dtype_tamanho((DType) c->dtype) > c->passo) {
+    fprintf(stderr, "Erro: cabeçalho inválido em %s\n", filename);
+    formato_fechar(arq);
+    return -1;
+  }
+  return 0;
+}
+
+// Converte uma linha bruta do arquivo para doubles
+static void converter_linha(const CabecalhoV2 *c, const unsigned char *linha,
+                            double *saida) {
+  switch ((DType) c->dtype) {
+  case DTYPE_FLOAT64:
+    memcpy(saida, linha, c->d * sizeof(double));
+    break;
+  case DTYPE_FLOAT32:
+    for (uint32_t j = 0; j < c->d; j++) {
+      float v;
+      memcpy(&v, linha + j * sizeof(float), sizeof(float));
+      saida[j] = v;
+    }
+    break;
+  case DTYPE_INT8:
+    for (uint32_t j = 0; j < c->d; j++) {
+      saida[j] = ((const int8_t*) linha)[j] * c->escala;
+    }
+    break;
+  }
+}
+
+// Lê `n` elementos de `tamanho` bytes a partir de `offset`, acumulando o hash
+static int ler_secao(FILE *file, uint64_t offset, void *buf, size_t tamanho,
+                     int n, uint64_t *h) {
+  if (fseeko(file, (off_t) offset, SEEK_SET) != 0 ||
+      fread(buf, tamanho, n, file) != (size_t) n) {
+    return -1;
+  }
+  if (h) *h = formato_checksum(*h, buf, tamanho * n);
+  return 0;
+}
+
+int formato_ler_pontos(ArquivoDataset *arq, int ini, int fim, Ponto **pontos) {
+  const CabecalhoV2 *c = &arq->cab;
+  if (ini < 0 || fim < ini || (uint64_t) fim > c->n) {
+    fprintf(stderr, "Erro: intervalo de linhas [%d, %d) fora do dataset (%llu pontos)\n",
+            ini, fim, (unsigned long long) c->n);
+    return -1;
+  }
+
+  int n = fim - ini;
+  size_t passo_mem = alinhar(c->d * sizeof(double), FORMATO_ALINHAMENTO_LINHA) /
+                     sizeof(double);
+  // Só é possível verificar o checksum quando o arquivo inteiro é lido
+  int verificar = !arq->legado && ini == 0 && (uint64_t) fim == c->n;
+  uint64_t h = FORMATO_CHECKSUM_INICIAL;
+
+  Ponto *p = (Ponto*) malloc((n > 0 ? n : 1) * sizeof(Ponto));
+  unsigned char *linha = (unsigned char*) malloc(c->passo);
+  void *bloco = NULL;
+  if (!p || !linha ||
+      (n > 0 && posix_memalign(&bloco, FORMATO_ALINHAMENTO_LINHA,
+                               n * passo_mem * sizeof(double)) != 0)) {
+    fprintf(stderr, "Erro de alocação de memória para %d pontos\n", n);
+    free(p);
+    free(linha);
+    return -1;
+  }
+  if (n > 0) memset(bloco, 0, n * passo_mem * sizeof(double));
+
+  if (fseeko(arq->file, (off_t) (c->offset_dados + (uint64_t) ini * c->passo),
+             SEEK_SET) != 0) {
+    fprintf(stderr, "Erro ao posicionar leitura na linha %d\n", ini);
+    goto erro;
+  }
+  for (int i = 0; i < n; i++) {
+    if (fread(linha, 1, c->passo, arq->file) != c->passo) {
+      fprintf(stderr, "Erro ao ler features do ponto %d\n", ini + i);
+      goto erro;
+    }
+    if (verificar) h = formato_checksum(h, linha, c->passo);
+    p[i].features = (double*) bloco + i * passo_mem;
+    p[i].id = ini + i; // Sem seção de ids, o id é o índice global
+    p[i].rotulo = -1;
+    converter_linha(c, linha, p[i].features);
+  }
+
+  if (c->offset_ids && n > 0) {
+    int64_t *ids = (int64_t*) malloc(n * sizeof(int64_t));
+    if (!ids || ler_secao(arq->file, c->offset_ids + (uint64_t) ini * sizeof(int64_t),
+                          ids, sizeof(int64_t), n, verificar ? &h : NULL) != 0) {
+      fprintf(stderr, "Erro ao ler a seção de ids\n");
+      free(ids);
+      goto erro;
+    }
+    for (int i = 0; i < n; i++) {
+      // Os pontos guardam o id em um int, e -1 marca vizinho ausente
+      if (ids[i] < 0 || ids[i] > INT_MAX) {
+        fprintf(stderr, "Erro: id %lld do ponto %d fora do intervalo [0, %d]\n",
+                (long long) ids[i], ini + i, INT_MAX);
+        free(ids);
+        goto erro;
+      }
+      p[i].id = (int) ids[i];
+    }
+    free(ids);
+  }
+
+  if (c->offset_rotulos && n > 0) {
+    int32_t *rotulos = (int32_t*) malloc(n * sizeof(int32_t));
+    if (!rotulos ||
+        ler_secao(arq->file, c->offset_rotulos + (uint64_t) ini * sizeof(int32_t),
+                  rotulos, sizeof(int32_t), n, verificar ? &h : NULL) != 0) {
+      fprintf(stderr, "Erro ao ler a seção de rótulos\n");
+      free(rotulos);
+      goto erro;
+    }
+    for (int i = 0; i < n; i++) p[i].rotulo = rotulos[i];
+    free(rotulos);
+  }
+
+  if (verificar && h != c->checksum) {
+    fprintf(stderr, "Erro: checksum inválido (esperado %016llx, obtido %016llx)\n",
+            (unsigned long long) c->checksum, (unsigned long long) h);
+    goto erro;
+  }
+
+  free(linha);
+  *pontos = p;
+  return 0;
+
+erro:
+  free(linha);
+  free(bloco);
+  free(p);
+  return -1;
+}
+
+int formato_ler_linha(const ArquivoDataset *arq, uint64_t linha, unsigned char *bruto,
+                      double *saida) {
+  const CabecalhoV2 *c = &arq->cab;
+  if (linha >= c->n) return -1;
+  off_t offset = (off_t) (c->offset_dados + linha * c->passo);
+  size_t lidos = 0;
+  while (lidos < c->passo) {
+    ssize_t r = pread(fileno(arq->file), bruto + lidos, c->passo - lidos,
+                      offset + (off_t) lidos);
+    if (r <= 0) return -1;
+    lidos += (size_t) r;
+  }
+  converter_linha(c, bruto, saida);
+  return 0;
+}
+
+int formato_identificador(ArquivoDataset *arq, uint64_t *id) {
+  const CabecalhoV2 *c = &arq->cab;
+  if (!arq->legado) {
+    *id = c->checksum;
+    return 0;
+  }
+
+  unsigned char *linha = (unsigned char*) malloc(c->passo);
+  if (!linha || fseeko(arq->file, (off_t) c->offset_dados, SEEK_SET) != 0) {
+    free(linha);
+    return -1;
+  }
+  uint64_t h = FORMATO_CHECKSUM_INICIAL;
+  for (uint64_t i = 0; i < c->n; i++) {
+    if (fread(linha, 1, c->passo, arq->file) != c->passo) {
+      fprintf(stderr, "Erro ao ler o ponto %llu para o identificador\n",
+              (unsigned long long) i);
+      free(linha);
+      return -1;
+    }
+    h = formato_checksum(h, linha, c->passo);
+  }
+  free(linha);
+  *id = h;
+  return 0;
+}
+
+void formato_fechar(ArquivoDataset *arq) {
+  if (arq->file) fclose(arq->file);
+  arq->file = NULL;
+}
+
+void formato_liberar_pontos(Ponto *pontos, int n) {
+  if (!pontos) return;
+  // As features de todos os pontos vivem no bloco iniciado pelo primeiro
+  if (n > 0) free(pontos[0].features);
+  free(pontos);
+}
+
+int formato_escritor_abrir(EscritorDataset *w, const char *filename, DType dtype,
+                           int n, int d, double escala, int com_ids,
+                           int com_rotulos) {
+  memset(w, 0, sizeof(*w));
+  if (n < 0 || d <= 0) {
+    fprintf(stderr, "Erro: dimensões inválidas para %s (N=%d, D=%d)\n", filename, n, d);
+    return -1;
+  }
+  if (dtype == DTYPE_INT8 && !(escala > 0)) {
+    fprintf(stderr, "Erro: dados int8 exigem escala positiva\n");
+    return -1;
+  }
+
+  CabecalhoV2 *c = &w->cab;
+  memcpy(c->magico, FORMATO_MAGICO, 4);
+  c->versao = FORMATO_VERSAO;
+  c->dtype = dtype;
+  c->n = n;
+  c->d = d;
+  c->passo = alinhar((uint64_t) d * dtype_tamanho(dtype), FORMATO_ALINHAMENTO_LINHA);
+  c->offset_dados = alinhar(sizeof(CabecalhoV2), FORMATO_ALINHAMENTO_DADOS);
+  uint64_t fim_dados = c->offset_dados + (uint64_t) n * c->passo;
+  c->offset_ids = com_ids ? fim_dados : 0;
+  c->offset_rotulos =
+      com_rotulos ? fim_dados + (com_ids ? (uint64_t) n * sizeof(int64_t) : 0) : 0;
+  c->escala = dtype == DTYPE_INT8 ? escala : 1.0;
+  c->checksum = FORMATO_CHECKSUM_INICIAL;
+
+  w->linha = (unsigned char*) calloc(c->passo, 1);
+  w->ids = com_ids ? (int64_t*) malloc((n > 0 ? n : 1) * sizeof(int64_t)) : NULL;
+  w->rotulos = com_rotulos ? (int32_t*) malloc((n > 0 ? n : 1) * sizeof(int32_t)) : NULL;
+  if (!w->linha || (com_ids && !w->ids) || (com_rotulos && !w->rotulos)) {
+    fprintf(stderr, "Erro de alocação de memória para o escritor de %s\n", filename);
+    goto erro;
+  }
+
+  w->file = fopen(filename, "wb");
+  if (!w->file) {
+    perror("Erro ao criar arquivo");
+    goto erro;
+  }
+  // O cabeçalho definitivo é gravado no fechamento, quando o checksum é conhecido
+  if (fwrite(c, sizeof(*c), 1, w->file) != 1 ||
+      fseeko(w->file, (off_t) c->offset_dados, SEEK_SET) != 0) {
+    fprintf(stderr, "Erro ao gravar o cabeçalho de %s\n", filename);
+    fclose(w->file);
+    goto erro;
+  }
+  return 0;
+
+erro:
+  free(w->linha);
+  free(w->ids);
+  free(w->rotulos);
+  memset(w, 0, sizeof(*w));
+  return -1;
+}
+
+int formato_escritor_linha(EscritorDataset *w, const double *features,
+                           int64_t id, int32_t rotulo) {
+  CabecalhoV2 *c = &w->cab;
+  if (w->escritos >= c->n) {
+    fprintf(stderr, "Erro: mais linhas gravadas do que as %llu declaradas\n",
+            (unsigned long long) c->n);
+    return -1;
+  }
+
+  switch ((DType) c->dtype) {
+  case DTYPE_FLOAT64:
+    memcpy(w->linha, features, c->d * sizeof(double));
+    break;
+  case DTYPE_FLOAT32:
+    for (uint32_t j = 0; j < c->d; j++) {
+      float v = (float) features[j];
+      memcpy(w->linha + j * sizeof(float), &v, sizeof(float));
+    }
+    break;
+  case DTYPE_INT8:
+    for (uint32_t j = 0; j < c->d; j++) {
+      long q = lround(features[j] / c->escala);
+      if (q > 127) q = 127;
+      if (q < -127) q = -127;
+      ((int8_t*) w->linha)[j] = (int8_t) q;
+    }
+    break;
+  }
+
+  if (fwrite(w->linha, 1, c->passo, w->file) != c->passo) {
+    fprintf(stderr, "Erro ao gravar o ponto %llu\n", (unsigned long long) w->escritos);
+    return -1;
+  }
+  c->checksum = formato_checksum(c->checksum, w->linha, c->passo);
+  if (w->ids) w->ids[w->escritos] = id;
+  if (w->rotulos) w->rotulos[w->escritos] = rotulo;
+  w->escritos++;
+  return 0;
+}
+
+int formato_escritor_fechar(EscritorDataset *w) {
+  CabecalhoV2 *c = &w->cab;
+  int ret = 0;
+
+  if (w->escritos != c->n) {
+    fprintf(stderr, "Erro: %llu linhas gravadas, %llu declaradas\n",
+            (unsigned long long) w->escritos, (unsigned long long) c->n);
+    ret = -1;
+  }
+  if (ret == 0 && w->ids) {
+    c->checksum = formato_checksum(c->checksum, w->ids, c->n * sizeof(int64_t));
+    if (fwrite(w->ids, sizeof(int64_t), c->n, w->file) != c->n) ret = -1;
+  }
+  if (ret == 0 && w->rotulos) {
+    c->checksum = formato_checksum(c->checksum, w->rotulos, c->n * sizeof(int32_t));
+    if (fwrite(w->rotulos, sizeof(int32_t), c->n, w->file) != c->n) ret = -1;
+  }
+  if (ret == 0 && (fseeko(w->file, 0, SEEK_SET) != 0 ||
+                   fwrite(c, sizeof(*c), 1, w->file) != 1)) {
+    ret = -1;
+  }
+  if (fclose(w->file) != 0) ret = -1;
+  if (ret != 0) fprintf(stderr, "Erro ao finalizar o arquivo do dataset\n");
+
+  free(w->linha);
+  free(w->ids);
+  free(w->rotulos);
+  memset(w, 0, sizeof(*w));
+  return ret;
+}
@@ -0,0 +1,240 @@
+/**
+ * @file formato.h
+ * @brief Leitura e escrita do formato binário de datasets (v2 e legado).
+ *
+ * O formato legado consiste apenas em `[int N][int D][double ...]`, sem
+ * número mágico, versão, tipo de dado ou garantia de alinhamento. O formato
+ * v2 acrescenta um cabeçalho fixo de 64 bytes:
+ *
+ * | campo            | tipo       | descrição                                   |
+ * |------------------|------------|---------------------------------------------|
+ * | `magico`         | `char[4]`  | sempre `"KNN2"`                             |
+ * | `versao`         | `uint16_t` | versão do formato (2)                       |
+ * | `dtype`          | `uint16_t` | tipo das features (ver ::DType)             |
+ * | `n`              | `uint64_t` | número de pontos                            |
+ * | `d`              | `uint32_t` | número de dimensões                         |
+ * | `passo`          | `uint32_t` | bytes por linha, múltiplo de 64             |
+ * | `offset_dados`   | `uint64_t` | início dos dados, múltiplo de 4096          |
+ * | `offset_ids`     | `uint64_t` | seção de ids `int64_t` (0 se ausente)       |
+ * | `offset_rotulos` | `uint64_t` | seção de rótulos `int32_t` (0 se ausente)   |
+ * | `escala`         | `double`   | fator de escala dos dados `int8`            |
+ * | `checksum`       | `uint64_t` | hash dos dados, ids e rótulos               |
+ *
+ * Como cada linha começa em um múltiplo de 64 bytes e a seção de dados
+ * começa em uma fronteira de página, o arquivo pode ser mapeado em memória
+ * e suas linhas usadas diretamente por rotinas vetorizadas.
+ */
+
+#ifndef FORMATO_H
+#define FORMATO_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "knn.h"
+
+#define FORMATO_MAGICO "KNN2"      /**< Número mágico do formato v2. */
+#define FORMATO_VERSAO 2           /**< Versão atual do formato. */
+#define FORMATO_ALINHAMENTO_LINHA 64    /**< Alinhamento de cada linha (bytes). */
+#define FORMATO_ALINHAMENTO_DADOS 4096  /**< Alinhamento da seção de dados (bytes). */
+
+/**
+ * @brief Tipo de dado usado para armazenar as features no arquivo.
+ *
+ * Independentemente do tipo no disco, os pontos são sempre convertidos para
+ * `double` ao serem carregados. No tipo `DTYPE_INT8` o valor real é dado por
+ * `valor * escala`.
+ */
+typedef enum {
+  DTYPE_FLOAT64 = 0, /**< `double` (padrão, equivalente ao formato legado). */
+  DTYPE_FLOAT32 = 1, /**< `float`. */
+  DTYPE_INT8 = 2     /**< `int8_t` quantizado com fator `escala`. */
+} DType;
+
+/**
+ * @brief Cabeçalho fixo de 64 bytes do formato v2.
+ */
+typedef struct {
+  char magico[4];          /**< `"KNN2"`. */
+  uint16_t versao;         /**< Versão do formato. */
+  uint16_t dtype;          /**< Tipo das features (::DType). */
+  uint64_t n;              /**< Número de pontos. */
+  uint32_t d;              /**< Número de dimensões. */
+  uint32_t passo;          /**< Bytes por linha, incluindo preenchimento. */
+  uint64_t offset_dados;   /**< Offset da seção de dados. */
+  uint64_t offset_ids;     /**< Offset da seção de ids (0 se ausente). */
+  uint64_t offset_rotulos; /**< Offset da seção de rótulos (0 se ausente). */
+  double escala;           /**< Escala dos dados `int8` (1.0 nos demais). */
+  uint64_t checksum;       /**< Hash de dados, ids e rótulos, nessa ordem. */
+} CabecalhoV2;
+
+/**
+ * @brief Arquivo de dataset aberto para leitura.
+ *
+ * @details Arquivos no formato legado são descritos pelo mesmo cabeçalho,
+ * preenchido com os valores equivalentes (`float64`, sem alinhamento e sem
+ * ids ou rótulos) e com o campo `legado` ligado.
+ */
+typedef struct {
+  FILE *file;      /**< Arquivo aberto em modo binário. */
+  CabecalhoV2 cab; /**< Cabeçalho lido (ou sintetizado, no legado). */
+  int legado;      /**< 1 se o arquivo está no formato legado. */
+} ArquivoDataset;
+
+/**
+ * @brief Escritor incremental de arquivos v2.
+ *
+ * @details Permite gravar um ponto por vez, sem manter o dataset inteiro em
+ * memória. Ids e rótulos são acumulados e gravados no fechamento, quando o
+ * checksum é finalizado e o cabeçalho é reescrito.
+ */
+typedef struct {
+  FILE *file;          /**< Arquivo de saída. */
+  CabecalhoV2 cab;     /**< Cabeçalho em construção. */
+  unsigned char *linha;/**< Buffer de uma linha já convertida. */
+  int64_t *ids;        /**< Ids acumulados (NULL se ausentes). */
+  int32_t *rotulos;    /**< Rótulos acumulados (NULL se ausentes). */
+  uint64_t escritos;   /**< Número de linhas já gravadas. */
+} EscritorDataset;
+
+/**
+ * @brief Nome textual de um tipo de dado (`"float64"`, `"float32"`, `"int8"`).
+ */
+const char *dtype_nome(DType dtype);
+
+/**
+ * @brief Converte um nome textual em ::DType.
+ *
+ * @return o tipo correspondente, ou -1 se o nome for desconhecido.
+ */
+int dtype_de_nome(const char *nome);
+
+/**
+ * @brief Tamanho em bytes de uma feature do tipo `dtype`.
+ */
+int dtype_tamanho(DType dtype);
+
+/**
+ * @brief Atualiza um hash FNV-1a de 64 bits com um bloco de bytes.
+ *
+ * @details O bloco é consumido em palavras de 8 bytes (os bytes finais, se
+ * houver, um a um), o que torna o cálculo barato mesmo para arquivos grandes.
+ *
+ * @param h Valor atual do hash (use `FORMATO_CHECKSUM_INICIAL` no início).
+ * @param buf Bloco de bytes.
+ * @param bytes Tamanho do bloco.
+ * @return Novo valor do hash.
+ */
+uint64_t formato_checksum(uint64_t h, const void *buf, size_t bytes);
+
+/** Valor inicial do hash usado por formato_checksum(). */
+#define FORMATO_CHECKSUM_INICIAL 0xcbf29ce484222325ULL
+
+/**
+ * @brief Abre um dataset, detectando automaticamente o formato.
+ *
+ * @details Se os primeiros bytes não forem o número mágico do v2, o arquivo é
+ * tratado como legado, desde que seu tamanho seja exatamente
+ * `8 + N * D * sizeof(double)`.
+ *
+ * @param filename Caminho do arquivo.
+ * @param arq Estrutura a ser preenchida.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int formato_abrir(const char *filename, ArquivoDataset *arq);
+
+/**
+ * @brief Lê as linhas `[ini, fim)` de um dataset aberto.
+ *
+ * @details Os pontos são armazenados em um único bloco contíguo de `double`,
+ * alinhado a 64 bytes e com passo também múltiplo de 64 bytes. O id de cada
+ * ponto é o id gravado no arquivo ou, se ausente, o índice global da linha;
+ * ids gravados fora de `[0, INT_MAX]` são rejeitados. Quando o arquivo
+ * inteiro é lido, o checksum do v2 é verificado.
+ *
+ * @param arq Arquivo aberto por formato_abrir().
+ * @param ini Primeira linha a ser lida.
+ * @param fim Linha seguinte à última a ser lida.
+ * @param pontos Recebe o vetor alocado de `fim - ini` pontos.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int formato_ler_pontos(ArquivoDataset *arq, int ini, int fim, Ponto **pontos);
+
+/**
+ * @brief Lê e converte uma única linha de um dataset aberto.
+ *
+ * @details Usa `pread`, sem mover a posição do arquivo, e por isso pode ser
+ * chamada por várias threads ao mesmo tempo, cada uma com seu buffer `bruto`.
+ *
+ * @param arq Arquivo aberto por formato_abrir().
+ * @param linha Índice da linha.
+ * @param bruto Buffer com espaço para `arq->cab.passo` bytes.
+ * @param saida Vetor com espaço para D doubles.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int formato_ler_linha(const ArquivoDataset *arq, uint64_t linha, unsigned char *bruto,
+                      double *saida);
+
+/**
+ * @brief Identificador do conteúdo de um dataset, para amarrar resultados a ele.
+ *
+ * @details No v2 é o próprio checksum do cabeçalho; no formato legado, que não
+ * tem checksum, o mesmo hash é calculado lendo a seção de dados.
+ *
+ * @param arq Arquivo aberto por formato_abrir().
+ * @param id Recebe o identificador.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int formato_identificador(ArquivoDataset *arq, uint64_t *id);
+
+/**
+ * @brief Fecha um dataset aberto por formato_abrir().
+ */
+void formato_fechar(ArquivoDataset *arq);
+
+/**
+ * @brief Libera um vetor de pontos alocado por formato_ler_pontos().
+ *
+ * @param pontos Vetor de pontos (pode ser NULL).
+ * @param n Número de pontos do vetor.
+ */
+void formato_liberar_pontos(Ponto *pontos, int n);
+
+/**
+ * @brief Cria um arquivo v2 para escrita incremental.
+ *
+ * @param w Escritor a ser inicializado.
+ * @param filename Caminho do arquivo de saída.
+ * @param dtype Tipo das features no disco.
+ * @param n Número de pontos que serão gravados.
+ * @param d Número de dimensões.
+ * @param escala Escala dos dados `int8` (ignorada nos demais tipos).
+ * @param com_ids 1 para gravar a seção de ids.
+ * @param com_rotulos 1 para gravar a seção de rótulos.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int formato_escritor_abrir(EscritorDataset *w, const char *filename, DType dtype,
+                           int n, int d, double escala, int com_ids,
+                           int com_rotulos);
+
+/**
+ * @brief Grava o próximo ponto no arquivo.
+ *
+ * @param w Escritor aberto.
+ * @param features Vetor com `d` features.
+ * @param id Id do ponto (ignorado se o arquivo não tiver ids).
+ * @param rotulo Rótulo do ponto (ignorado se o arquivo não tiver rótulos).
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int formato_escritor_linha(EscritorDataset *w, const double *features,
+                           int64_t id, int32_t rotulo);
+
+/**
+ * @brief Finaliza o arquivo: grava ids, rótulos e o cabeçalho definitivo.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro (ou se o número de
+ * linhas gravadas for diferente do declarado).
+ */
+int formato_escritor_fechar(EscritorDataset *w);
+
+#endif // !FORMATO_H
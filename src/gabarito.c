@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gabarito.h"
+#include "utils.h"
+
+// Folga relativa para considerar um vizinho empatado com o K-ésimo exato
+#define FOLGA_EMPATE (1 + 1e-12)
+
+int gabarito_gravar(const char *arquivo, const CabecalhoGabarito *cab,
+                    const Vizinho *vizinhos) {
+  CabecalhoGabarito c = *cab;
+  memcpy(c.magico, GABARITO_MAGICO, 4);
+  c.versao = GABARITO_VERSAO;
+  c.reservado = 0;
+
+  FILE *file = fopen(arquivo, "wb");
+  if (!file) {
+    fprintf(stderr, "Erro ao criar arquivo de gabarito: %s\n", arquivo);
+    return -1;
+  }
+  size_t total = (size_t) c.m * c.k;
+  int ret = fwrite(&c, sizeof(c), 1, file) == 1 &&
+            fwrite(vizinhos, sizeof(Vizinho), total, file) == total ? 0 : -1;
+  if (fclose(file) != 0) ret = -1;
+  if (ret != 0) fprintf(stderr, "Erro ao gravar o gabarito em %s\n", arquivo);
+  return ret;
+}
+
+int gabarito_ler(const char *arquivo, Gabarito *g) {
+  g->vizinhos = NULL;
+  FILE *file = fopen(arquivo, "rb");
+  if (!file) {
+    fprintf(stderr, "Erro ao abrir arquivo de gabarito: %s\n", arquivo);
+    return -1;
+  }
+  if (fread(&g->cab, sizeof(g->cab), 1, file) != 1 ||
+      memcmp(g->cab.magico, GABARITO_MAGICO, 4) != 0) {
+    fprintf(stderr, "Erro: %s não é um arquivo de gabarito\n", arquivo);
+    fclose(file);
+    return -1;
+  }
+  if (g->cab.versao != GABARITO_VERSAO || g->cab.k == 0) {
+    fprintf(stderr, "Erro: cabeçalho inválido em %s\n", arquivo);
+    fclose(file);
+    return -1;
+  }
+
+  size_t total = (size_t) g->cab.m * g->cab.k;
+  g->vizinhos = (Vizinho*) malloc(total * sizeof(Vizinho));
+  if (!g->vizinhos || fread(g->vizinhos, sizeof(Vizinho), total, file) != total) {
+    fprintf(stderr, "Erro: %s está truncado\n", arquivo);
+    free(g->vizinhos);
+    g->vizinhos = NULL;
+    fclose(file);
+    return -1;
+  }
+  fclose(file);
+  return 0;
+}
+
+int gabarito_conferir(const Gabarito *g, const Dataset *dataset,
+                      uint64_t id_treino, uint64_t id_teste) {
+  const CabecalhoGabarito *c = &g->cab;
+  if (c->n != (uint32_t) dataset->N || c->m != (uint32_t) dataset->M ||
+      c->d != (uint32_t) dataset->D) {
+    fprintf(stderr, "Erro: gabarito para N=%u M=%u D=%u, dataset tem N=%d M=%d D=%d\n",
+            c->n, c->m, c->d, dataset->N, dataset->M, dataset->D);
+    return -1;
+  }
+  if (c->id_treino != id_treino || c->id_teste != id_teste) {
+    fprintf(stderr, "Erro: o gabarito foi gerado a partir de outros datasets\n");
+    return -1;
+  }
+  return 0;
+}
+
+typedef struct {
+  int id;
+  int linha;
+} IdLinha;
+
+static int comparar_por_id(const void *a, const void *b) {
+  const IdLinha *x = (const IdLinha*) a;
+  const IdLinha *y = (const IdLinha*) b;
+  if (x->id != y->id) return x->id < y->id ? -1 : 1;
+  return (x->linha > y->linha) - (x->linha < y->linha);
+}
+
+// Pares (id, linha) do treino ordenados por id, ou NULL se o id já é a linha
+static IdLinha *indexar_ids(const Dataset *dataset, int *erro) {
+  *erro = 0;
+  int identidade = 1;
+  for (int i = 0; i < dataset->N && identidade; i++) {
+    identidade = dataset->treino[i].id == i;
+  }
+  if (identidade) return NULL;
+
+  IdLinha *pares = (IdLinha*) malloc(dataset->N * sizeof(IdLinha));
+  if (!pares) {
+    *erro = 1;
+    return NULL;
+  }
+  for (int i = 0; i < dataset->N; i++) {
+    pares[i].id = dataset->treino[i].id;
+    pares[i].linha = i;
+  }
+  qsort(pares, dataset->N, sizeof(IdLinha), comparar_por_id);
+  return pares;
+}
+
+// Linha do treino com o id dado, ou -1 se não existir
+static int localizar(const Dataset *dataset, const IdLinha *pares, int64_t id) {
+  if (!pares) return id >= 0 && id < dataset->N ? (int) id : -1;
+  int ini = 0, fim = dataset->N;
+  while (ini < fim) {
+    int meio = ini + (fim - ini) / 2;
+    if (pares[meio].id < id) {
+      ini = meio + 1;
+    } else {
+      fim = meio;
+    }
+  }
+  return ini < dataset->N && pares[ini].id == id ? pares[ini].linha : -1;
+}
+
+int gabarito_avaliar(const Gabarito *g, const Dataset *dataset,
+                     const Vizinho *resultado, int k_resultado, Metricas *m) {
+  int K = (int) g->cab.k;
+  if (k_resultado < K) {
+    fprintf(stderr, "Erro: o resultado tem K=%d, menor que o K=%d do gabarito\n",
+            k_resultado, K);
+    return -1;
+  }
+
+  int erro;
+  IdLinha *pares = indexar_ids(dataset, &erro);
+  // Última consulta em que cada linha do treino apareceu no resultado
+  int *marca = (int*) malloc((dataset->N > 0 ? dataset->N : 1) * sizeof(int));
+  if (erro || !marca) {
+    fprintf(stderr, "Erro de alocação de memória na avaliação\n");
+    free(pares);
+    free(marca);
+    return -1;
+  }
+  for (int i = 0; i < dataset->N; i++) marca[i] = -1;
+
+  double soma_recall = 0, soma_razao = 0;
+  long n_razao = 0, invalidos = 0;
+  for (int q = 0; q < dataset->M; q++) {
+    const Vizinho *exatos = g->vizinhos + (size_t) q * K;
+    const Vizinho *obtidos = resultado + (size_t) q * k_resultado;
+    const Ponto *consulta = &dataset->teste[q];
+    // Empates com o K-ésimo vizinho exato também contam como acerto
+    double corte = exatos[K - 1].dist * FOLGA_EMPATE;
+    int acertos = 0;
+
+    for (int j = 0; j < K; j++) {
+      int linha = localizar(dataset, pares, obtidos[j].id);
+      // Id -1, fora do treino ou repetido na consulta: erro, contado à parte
+      if (linha < 0 || marca[linha] == q) {
+        invalidos++;
+        continue;
+      }
+      marca[linha] = q;
+      double real = distancia(&dataset->treino[linha], consulta, dataset->D);
+      if (real <= corte) acertos++;
+      if (exatos[j].dist > 0) {
+        soma_razao += real / exatos[j].dist;
+        n_razao++;
+      } else if (real == 0) {
+        soma_razao += 1;
+        n_razao++;
+      }
+    }
+    soma_recall += (double) acertos / K;
+  }
+
+  free(marca);
+  free(pares);
+  m->recall = dataset->M > 0 ? soma_recall / dataset->M : 1;
+  m->razao = n_razao > 0 ? soma_razao / n_razao : 1;
+  m->invalidos = invalidos;
+  return 0;
+}
+
+void gabarito_libera(Gabarito *g) {
+  free(g->vizinhos);
+  g->vizinhos = NULL;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file gabarito.h
+ * @brief Gabarito (top-K exato) em disco e métricas de qualidade da busca.
+ *
+ * O gabarito guarda os K vizinhos exatos de cada ponto de teste, calculados
+ * uma única vez, junto com os identificadores de conteúdo dos datasets de
+ * treino e teste (ver formato_identificador()). Assim um gabarito nunca é
+ * usado com dados diferentes daqueles que o geraram.
+ *
+ * Após o cabeçalho de 40 bytes vêm `M * K` registros ::Vizinho, no mesmo
+ * layout dos arquivos parciais (parcial.h): ordenados por distância crescente
+ * dentro de cada consulta.
+ */
+
+#ifndef GABARITO_H
+#define GABARITO_H
+
+#include <stdint.h>
+
+#include "knn.h"
+#include "parcial.h"
+
+#define GABARITO_MAGICO "KNNG" /**< Número mágico dos arquivos de gabarito. */
+#define GABARITO_VERSAO 1      /**< Versão atual do formato de gabarito. */
+
+/**
+ * @brief Cabeçalho de 40 bytes de um arquivo de gabarito.
+ */
+typedef struct {
+  char magico[4];      /**< `"KNNG"`. */
+  uint16_t versao;     /**< Versão do formato. */
+  uint16_t reservado;  /**< Sempre zero. */
+  uint32_t m;          /**< Número de pontos de teste. */
+  uint32_t k;          /**< Número de vizinhos por ponto de teste. */
+  uint32_t n;          /**< Número de pontos de treino. */
+  uint32_t d;          /**< Número de dimensões. */
+  uint64_t id_treino;  /**< Identificador de conteúdo do treino. */
+  uint64_t id_teste;   /**< Identificador de conteúdo do teste. */
+} CabecalhoGabarito;
+
+/**
+ * @brief Gabarito carregado em memória.
+ */
+typedef struct {
+  CabecalhoGabarito cab; /**< Cabeçalho do arquivo. */
+  Vizinho *vizinhos;     /**< `m * k` vizinhos exatos. */
+} Gabarito;
+
+/**
+ * @brief Qualidade de um resultado em relação ao gabarito.
+ */
+typedef struct {
+  double recall; /**< Fração média dos K vizinhos exatos encontrados. */
+  double razao;  /**< Média de dist. real do j-ésimo encontrado / j-ésimo exato. */
+  long invalidos; /**< Vizinhos devolvidos com id -1, fora do treino ou repetido. */
+} Metricas;
+
+/**
+ * @brief Grava um gabarito.
+ *
+ * @param arquivo Caminho do arquivo de saída.
+ * @param cab Cabeçalho (magico, versao e reservado são preenchidos aqui).
+ * @param vizinhos `m * k` vizinhos exatos, ordenados por consulta.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int gabarito_gravar(const char *arquivo, const CabecalhoGabarito *cab,
+                    const Vizinho *vizinhos);
+
+/**
+ * @brief Lê um gabarito inteiro para a memória.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int gabarito_ler(const char *arquivo, Gabarito *g);
+
+/**
+ * @brief Confere se o gabarito corresponde aos datasets informados.
+ *
+ * @param g Gabarito carregado.
+ * @param dataset Dataset carregado (N, M e D são comparados).
+ * @param id_treino Identificador de conteúdo do treino.
+ * @param id_teste Identificador de conteúdo do teste.
+ * @return 0 se corresponde, -1 caso contrário (com mensagem em stderr).
+ */
+int gabarito_conferir(const Gabarito *g, const Dataset *dataset,
+                      uint64_t id_treino, uint64_t id_teste);
+
+/**
+ * @brief Calcula recall@K e razão de distâncias de um resultado.
+ *
+ * @details Só os K primeiros vizinhos de cada consulta do resultado são
+ * considerados, com K do gabarito. A razão usa a distância real de cada id
+ * devolvido, recalculada a partir do treino, e não a distância informada
+ * pelo motor, de modo que motores aproximados não mascarem o erro.
+ *
+ * Cada ponto de treino conta no máximo uma vez por consulta. Ids -1, que não
+ * existem no treino ou repetidos na mesma consulta contam como erro no
+ * recall, ficam fora da razão e são contados em `invalidos`.
+ *
+ * @param g Gabarito carregado.
+ * @param dataset Dataset com treino e teste carregados.
+ * @param resultado `M * k_resultado` vizinhos, ordenados por consulta.
+ * @param k_resultado Vizinhos por consulta no resultado (>= K do gabarito).
+ * @param m Recebe as métricas.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int gabarito_avaliar(const Gabarito *g, const Dataset *dataset,
+                     const Vizinho *resultado, int k_resultado, Metricas *m);
+
+/**
+ * @brief Libera a memória de um gabarito.
+ */
+void gabarito_libera(Gabarito *g);
+
+#endif // !GABARITO_H
@@ -1,7 +1,15 @@
 #include "heap.h"
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 
+int heap_comparar_elem(const void *a, const void *b) {
+    const HeapElem *x = (const HeapElem*) a;
+    const HeapElem *y = (const HeapElem*) b;
+    if (x->dist != y->dist) return x->dist < y->dist ? -1 : 1;
+    return (x->id > y->id) - (x->id < y->id);
+}
+
 void heap_init(Heap *h, int length) {
     h->data = (HeapElem*) malloc(sizeof(HeapElem) * length);
     h->n_elem = 0;
@@ -45,6 +53,11 @@ void heap_inserir(Heap *h, double dist, int id) {
     }
 }
 
+void heap_extrair_ordenado(const Heap *h, HeapElem *saida) {
+    memcpy(saida, h->data, sizeof(HeapElem) * h->n_elem);
+    qsort(saida, h->n_elem, sizeof(HeapElem), heap_comparar_elem);
+}
+
 void heap_libera(Heap *h) {
     free(h->data);
     pthread_mutex_destroy(&h->mutex);
@@ -91,6 +91,30 @@ void heap_descer(Heap *h, int i);
  */
 void heap_inserir(Heap *h, double dist, int id);
 
+/**
+ * @brief Compara dois ::HeapElem por distância e, em caso de empate, por `id`.
+ *
+ * @details Compatível com `qsort`; usada para ordenar resultados de forma
+ * determinística.
+ *
+ * @param a Ponteiro para o primeiro elemento.
+ * @param b Ponteiro para o segundo elemento.
+ * @return Negativo, zero ou positivo, como em `strcmp`.
+ */
+int heap_comparar_elem(const void *a, const void *b);
+
+/**
+ * @brief Copia os elementos da heap em ordem crescente de distância.
+ *
+ * @details A heap não é modificada. Empates de distância são desfeitos pelo
+ * menor `id`, de modo que a saída seja determinística.
+ *
+ * @param h Ponteiro para uma heap previamente inicializada.
+ * @param saida Vetor com espaço para pelo menos `h->n_elem` elementos.
+ * @return void
+ */
+void heap_extrair_ordenado(const Heap *h, HeapElem *saida);
+
 /**
  * @brief Libera a memória associada à heap.
  *
@@ -0,0 +1,113 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "indice.h"
+#include "utils.h"
+
+// Folga relativa no corte pela pior distância da heap (ver motor.c)
+#define FOLGA_CORTE (1 + 1e-12)
+// Folga relativa à norma da consulta, para cobrir o arredondamento das normas
+#define FOLGA_NORMA 1e-9
+
+typedef struct {
+  double norma;
+  int linha;
+} NormaLinha;
+
+static int comparar_norma(const void *a, const void *b) {
+  const NormaLinha *x = (const NormaLinha*) a;
+  const NormaLinha *y = (const NormaLinha*) b;
+  if (x->norma != y->norma) return x->norma < y->norma ? -1 : 1;
+  return (x->linha > y->linha) - (x->linha < y->linha);
+}
+
+static double norma(const Ponto *p, int D) {
+  double soma = 0;
+  for (int i = 0; i < D; i++) soma += p->features[i] * p->features[i];
+  return sqrt(soma);
+}
+
+int indice_normas_construir(IndiceNormas *indice, const Ponto *treino, int N, int D) {
+  NormaLinha *pares = (NormaLinha*) malloc(N * sizeof(NormaLinha));
+  indice->N = N;
+  indice->normas = (double*) malloc(N * sizeof(double));
+  indice->ordem = (int*) malloc(N * sizeof(int));
+  if (!pares || !indice->normas || !indice->ordem) {
+    fprintf(stderr, "Erro de alocação de memória para o índice\n");
+    free(pares);
+    indice_normas_libera(indice);
+    return -1;
+  }
+
+  for (int i = 0; i < N; i++) {
+    pares[i] = (NormaLinha){norma(&treino[i], D), i};
+  }
+  qsort(pares, N, sizeof(NormaLinha), comparar_norma);
+  for (int i = 0; i < N; i++) {
+    indice->normas[i] = pares[i].norma;
+    indice->ordem[i] = pares[i].linha;
+  }
+  free(pares);
+  return 0;
+}
+
+// Primeira posição do índice com norma >= `valor`
+static int primeira_posicao(const IndiceNormas *indice, double valor) {
+  int ini = 0, fim = indice->N;
+  while (ini < fim) {
+    int meio = ini + (fim - ini) / 2;
+    if (indice->normas[meio] < valor) {
+      ini = meio + 1;
+    } else {
+      fim = meio;
+    }
+  }
+  return ini;
+}
+
+void indice_normas_buscar(const IndiceNormas *indice, const Ponto *treino, int D,
+                          const Ponto *q, Heap *h) {
+  double nq = norma(q, D);
+  double folga = FOLGA_NORMA * nq;
+
+  int baixo = primeira_posicao(indice, nq) - 1, alto = baixo + 1;
+
+  while (baixo >= 0 || alto < indice->N) {
+    double dif_baixo = baixo >= 0 ? nq - indice->normas[baixo] : INFINITY;
+    double dif_alto = alto < indice->N ? indice->normas[alto] - nq : INFINITY;
+    int lado_alto = dif_alto <= dif_baixo;
+    double dif = lado_alto ? dif_alto : dif_baixo;
+
+    double limite = INFINITY;
+    if (h->n_elem == h->length) {
+      double pior = h->data[0].dist;
+      // O lado escolhido é o de menor diferença: se ele não serve, o outro também não
+      if (dif > pior * FOLGA_CORTE + folga) break;
+      limite = pior * pior * FOLGA_CORTE;
+    }
+
+    int linha = indice->ordem[lado_alto ? alto++ : baixo--];
+    double d2 = distancia2_limitada(&treino[linha], q, D, limite);
+    if (d2 <= limite) {
+      heap_inserir(h, sqrt(d2), treino[linha].id);
+    }
+  }
+}
+
+void indice_normas_faixa(const IndiceNormas *indice, const Ponto *q, int D, double raio,
+                         int *ini, int *fim) {
+  double nq = norma(q, D);
+  double margem = raio * FOLGA_CORTE + FOLGA_NORMA * nq;
+  *ini = primeira_posicao(indice, nq - margem);
+  *fim = *ini;
+  while (*fim < indice->N && indice->normas[*fim] <= nq + margem) (*fim)++;
+}
+
+void indice_normas_libera(IndiceNormas *indice) {
+  free(indice->normas);
+  free(indice->ordem);
+  indice->normas = NULL;
+  indice->ordem = NULL;
+  indice->N = 0;
+}
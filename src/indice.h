@@ -0,0 +1,65 @@
+/**
+ * @file indice.h
+ * @brief Índice exato do treino ordenado pela norma dos pontos.
+ *
+ * Pela desigualdade triangular, `| ||q|| - ||t|| | <= ||q - t||`. Com o treino
+ * ordenado pela norma, a busca de uma consulta começa nos pontos de norma
+ * mais próxima da sua e avança para os dois lados; quando a diferença de
+ * normas passa da pior distância da heap cheia, nenhum ponto adiante naquele
+ * lado pode entrar nos K vizinhos e o lado é encerrado. O resultado é o mesmo
+ * da força bruta, e o ganho depende de quão espalhadas estão as normas.
+ *
+ * Na busca por raio o corte é fixo: só os pontos com `| ||q|| - ||t|| | <= r`
+ * podem estar a distância `<= r`, e eles formam uma faixa contígua do índice.
+ */
+
+#ifndef INDICE_H
+#define INDICE_H
+
+#include "heap.h"
+#include "knn.h"
+
+/**
+ * @brief Treino ordenado por norma.
+ */
+typedef struct {
+  int N;          /**< Número de pontos indexados. */
+  double *normas; /**< Normas em ordem crescente. */
+  int *ordem;     /**< Linha do treino correspondente a cada norma. */
+} IndiceNormas;
+
+/**
+ * @brief Calcula as normas do treino e as ordena.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int indice_normas_construir(IndiceNormas *indice, const Ponto *treino, int N, int D);
+
+/**
+ * @brief Insere em `h` os K vizinhos exatos da consulta `q`.
+ *
+ * @param indice Índice construído sobre `treino`.
+ * @param treino Pontos de treino indexados.
+ * @param D Número de dimensões.
+ * @param q Ponto de consulta.
+ * @param h Heap vazia com capacidade K, usada sem trava.
+ */
+void indice_normas_buscar(const IndiceNormas *indice, const Ponto *treino, int D,
+                          const Ponto *q, Heap *h);
+
+/**
+ * @brief Faixa do índice que pode conter pontos a distância `<= raio` de `q`.
+ *
+ * @details As posições `[*ini, *fim)` do índice (linhas `indice->ordem[p]`
+ * do treino) são as de norma a até `raio` da norma de `q`, com uma pequena
+ * folga para o arredondamento; nenhum ponto fora delas está dentro do raio.
+ */
+void indice_normas_faixa(const IndiceNormas *indice, const Ponto *q, int D, double raio,
+                         int *ini, int *fim);
+
+/**
+ * @brief Libera a memória do índice.
+ */
+void indice_normas_libera(IndiceNormas *indice);
+
+#endif // !INDICE_H
@@ -12,6 +12,7 @@
 typedef struct {
   double *features; /**< Vetor de features */
   int id;           /**< rótulo do ponto   */
+  int rotulo;       /**< classe do ponto (-1 se ausente no arquivo) */
 } Ponto;
 
 /**
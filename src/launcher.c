@@ -0,0 +1,177 @@
+/**
+ * @file launcher.c
+ * @brief Execução local em shards: um processo `knn_main` por fatia de treino.
+ *
+ * Divide o conjunto de treino em N_PROCESSOS fatias contíguas, dispara um
+ * `knn_main --shard a b --parcial ...` para cada uma com `fork`/`execv`,
+ * aguarda todos terminarem e combina os resultados parciais com `knn_merge`.
+ * Os executáveis são procurados no mesmo diretório do `knn_launch`.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "formato.h"
+
+#define TAM_CAMINHO 4096
+
+/**
+ * @brief Monta o caminho de um executável irmão de `programa`.
+ */
+static void caminho_irmao(const char *programa, const char *nome, char *saida) {
+  const char *barra = strrchr(programa, '/');
+  if (barra) {
+    snprintf(saida, TAM_CAMINHO, "%.*s%s", (int) (barra - programa) + 1, programa, nome);
+  } else {
+    snprintf(saida, TAM_CAMINHO, "./%s", nome);
+  }
+}
+
+/**
+ * @brief Cria um processo filho que executa `argv[0]` com os argumentos dados.
+ *
+ * @param silencioso Se 1, a saída padrão do filho é descartada.
+ * @return pid do filho, ou -1 em caso de erro.
+ */
+static pid_t disparar(char *const argv[], int silencioso) {
+  fflush(stdout); // Evita que o filho herde e repita a saída pendente
+  pid_t pid = fork();
+  if (pid == 0) {
+    if (silencioso && !freopen("/dev/null", "w", stdout)) _exit(127);
+    execv(argv[0], argv);
+    fprintf(stderr, "Erro ao executar %s\n", argv[0]);
+    _exit(127);
+  }
+  if (pid < 0) perror("Erro ao criar processo");
+  return pid;
+}
+
+/**
+ * @brief Aguarda um processo filho e informa se ele terminou com sucesso.
+ */
+static int aguardar(pid_t pid, const char *descricao) {
+  int status;
+  if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "Erro: %s falhou\n", descricao);
+    return -1;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 6 && argc != 7) {
+    fprintf(stderr, "Uso: %s <arquivo_treino> <arquivo_teste> <K> <N_PROCESSOS> <N_THREADS> [saida]\n", argv[0]);
+    fprintf(stderr, "  N_PROCESSOS: número de shards (processos knn_main)\n");
+    fprintf(stderr, "  N_THREADS: threads por processo e na combinação\n");
+    fprintf(stderr, "  saida: arquivo texto de resultados (padrão: output.txt)\n");
+    fprintf(stderr, "Exemplo: %s train.bin test.bin 3 4 2\n", argv[0]);
+    return 1;
+  }
+
+  const char *saida = argc == 7 ? argv[6] : "output.txt";
+  int num_processos = atoi(argv[4]);
+  if (num_processos <= 0 || atoi(argv[5]) <= 0) {
+    fprintf(stderr, "Erro: número de processos e de threads devem ser positivos\n");
+    return 1;
+  }
+
+  ArquivoDataset treino;
+  if (formato_abrir(argv[1], &treino) != 0) return 1;
+  int N = (int) treino.cab.n;
+  formato_fechar(&treino);
+  if (num_processos > N) num_processos = N > 0 ? N : 1;
+
+  char knn_main[TAM_CAMINHO], knn_merge[TAM_CAMINHO];
+  caminho_irmao(argv[0], "knn_main", knn_main);
+  caminho_irmao(argv[0], "knn_merge", knn_merge);
+
+  char (*parciais)[TAM_CAMINHO] = malloc(num_processos * sizeof(*parciais));
+  pid_t *pids = (pid_t*) malloc(num_processos * sizeof(pid_t));
+  if (!parciais || !pids) {
+    fprintf(stderr, "Erro de alocação de memória para os processos\n");
+    return 1;
+  }
+
+  struct timeval inicio, fim_shards, fim;
+  gettimeofday(&inicio, NULL);
+  printf("Disparando %d shards de %s (%d pontos de treino)...\n", num_processos, argv[1], N);
+
+  int ret = 0;
+  int disparados = 0;
+  int pontos_por_shard = N / num_processos;
+  int pontos_restantes = N % num_processos;
+  for (int i = 0; i < num_processos; i++) {
+    // Mesma divisão usada entre as threads: o último shard pega o resto
+    int a = i * pontos_por_shard;
+    int b = a + pontos_por_shard + (i == num_processos - 1 ? pontos_restantes : 0);
+    char str_a[16], str_b[16];
+    snprintf(str_a, sizeof(str_a), "%d", a);
+    snprintf(str_b, sizeof(str_b), "%d", b);
+    snprintf(parciais[i], TAM_CAMINHO, "%s.shard%d.part", saida, i);
+
+    char *args[] = {knn_main, argv[1], argv[2], argv[3], argv[5], "--shard", str_a,
+                    str_b, "--parcial", parciais[i], NULL};
+    pids[i] = disparar(args, 1);
+    if (pids[i] < 0) {
+      ret = 1;
+      break;
+    }
+    printf("  shard %d: treino [%d, %d), pid %d\n", i, a, b, (int) pids[i]);
+    disparados++;
+  }
+
+  for (int i = 0; i < disparados; i++) {
+    char descricao[64];
+    snprintf(descricao, sizeof(descricao), "shard %d", i);
+    if (aguardar(pids[i], descricao) != 0) ret = 1;
+  }
+  gettimeofday(&fim_shards, NULL);
+
+  if (ret == 0) {
+    char combinado[TAM_CAMINHO];
+    snprintf(combinado, TAM_CAMINHO, "%s.part", saida);
+
+    char **args = (char**) malloc((num_processos + 6) * sizeof(char*));
+    if (!args) {
+      fprintf(stderr, "Erro de alocação de memória para os argumentos\n");
+      ret = 1;
+    } else {
+      int n = 0;
+      args[n++] = knn_merge;
+      args[n++] = argv[5];
+      args[n++] = combinado;
+      for (int i = 0; i < num_processos; i++) args[n++] = parciais[i];
+      args[n++] = "--texto";
+      args[n++] = (char*) saida;
+      args[n] = NULL;
+
+      pid_t pid = disparar(args, 0);
+      if (pid < 0 || aguardar(pid, "knn_merge") != 0) ret = 1;
+      free(args);
+    }
+  }
+
+  // Os parciais de cada shard são intermediários
+  for (int i = 0; i < disparados; i++) unlink(parciais[i]);
+  free(parciais);
+  free(pids);
+
+  gettimeofday(&fim, NULL);
+  if (ret != 0) {
+    fprintf(stderr, "Falha na execução em shards\n");
+    return 1;
+  }
+
+  printf("Tempo dos shards: %.6f segundos\n",
+         (fim_shards.tv_sec - inicio.tv_sec) + (fim_shards.tv_usec - inicio.tv_usec) / 1000000.0);
+  printf("Tempo total de execução: %.6f segundos\n",
+         (fim.tv_sec - inicio.tv_sec) + (fim.tv_usec - inicio.tv_usec) / 1000000.0);
+  return 0;
+}
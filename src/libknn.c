@@ -0,0 +1,517 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ajuste.h"
+#include "formato.h"
+#include "indice.h"
+#include "libknn.h"
+#include "pool.h"
+#include "pq.h"
+#include "trace.h"
+#include "utils.h"
+
+// Consultas retiradas de uma vez por thread na busca pelo índice
+#define CONSULTAS_POR_LOTE 16
+
+/**
+ * @brief Buffers de uma thread na busca pela PQ.
+ */
+typedef struct {
+  float *tabela;          /* tabela de distâncias da consulta */
+  uint8_t *tabela_q;      /* tabela quantizada (4 bits) */
+  Heap candidatos;        /* candidatos da varredura dos códigos */
+  double *linha;          /* linha original lida do disco */
+  unsigned char *bruto;   /* linha bruta do arquivo */
+} RascunhoPQ;
+
+struct KnnContexto {
+  Ponto *treino;          /* pontos de treino */
+  int N;                  /* número de pontos de treino */
+  int D;                  /* número de dimensões */
+  int dono;               /* 1 se o contexto libera o treino */
+  ConfigMotor cfg;        /* motor usado sem índice */
+  Pool *pool;             /* threads de trabalho */
+  IndiceNormas indice;    /* índice por norma */
+  int com_indice;         /* 1 se o índice foi construído */
+  IndicePQ pq;            /* treino quantizado */
+  int com_pq;             /* 1 se a PQ foi construída */
+  int rerank;             /* candidatos da PQ re-ranqueados (0 = nenhum) */
+  char *arquivo;          /* dataset de origem do treino (ou NULL) */
+  ArquivoDataset origem;  /* `arquivo` aberto, para o re-ranqueamento */
+  int com_origem;         /* 1 se `origem` está aberto */
+  pthread_mutex_t mutex;  /* serializa as chamadas */
+
+  // Buffers reaproveitados entre chamadas de knn_query_batch
+  Ponto *consultas;       /* vistas sobre as linhas das consultas */
+  int cap_consultas;
+  Heap *heaps;            /* uma heap por consulta */
+  int cap_heaps;
+  int cap_k;              /* capacidade alocada de cada heap */
+  HeapElem *ordenados;    /* cap_k elementos por thread */
+  RascunhoPQ *rascunhos;  /* um por thread, para a busca pela PQ */
+  int n_rascunhos;
+};
+
+/**
+ * @brief Argumentos das tarefas do pool de uma consulta.
+ */
+typedef struct {
+  KnnContexto *ctx;
+  Ponto *consultas;
+  Heap *heaps;
+  int M;
+  int K;
+  int proxima;            /* próxima consulta livre (busca pelo índice) */
+  pthread_mutex_t mutex;  /* protege `proxima` */
+  int64_t *out_ids;
+  double *out_dists;
+  int erro;               /* diferente de zero se alguma thread falhou */
+} Lote;
+
+static KnnContexto *criar(Ponto *treino, int N, int D, int num_threads, int dono) {
+  KnnContexto *ctx = (KnnContexto*) calloc(1, sizeof(KnnContexto));
+  if (!ctx) {
+    fprintf(stderr, "Erro de alocação de memória para o contexto\n");
+    return NULL;
+  }
+  ctx->treino = treino;
+  ctx->N = N;
+  ctx->D = D;
+  ctx->dono = dono;
+
+  Topologia topo;
+  ajuste_detectar_topologia(&topo);
+  ctx->cfg = (ConfigMotor){MOTOR_BLOCOS, num_threads, 0, 0};
+  motor_blocos_padrao(&ctx->cfg, D, topo.cache_l2);
+
+  ctx->pool = (Pool*) malloc(sizeof(Pool));
+  if (!ctx->pool || pool_criar(ctx->pool, num_threads) != 0) {
+    free(ctx->pool);
+    free(ctx);
+    return NULL;
+  }
+  pthread_mutex_init(&ctx->mutex, NULL);
+  return ctx;
+}
+
+KnnContexto *knn_create_from_file(const char *arquivo, int num_threads) {
+  ArquivoDataset arq;
+  Ponto *treino;
+  if (formato_abrir(arquivo, &arq) != 0) {
+    fprintf(stderr, "Falha ao abrir arquivo de treino: %s\n", arquivo);
+    return NULL;
+  }
+  int N = (int) arq.cab.n;
+  int D = (int) arq.cab.d;
+  int ret = formato_ler_pontos(&arq, 0, N, &treino);
+  formato_fechar(&arq);
+  if (ret != 0) return NULL;
+
+  KnnContexto *ctx = criar(treino, N, D, num_threads, 1);
+  if (!ctx) {
+    formato_liberar_pontos(treino, N);
+    return NULL;
+  }
+  ctx->arquivo = strdup(arquivo);
+  return ctx;
+}
+
+KnnContexto *knn_create_pq_from_file(const char *arquivo, int num_threads,
+                                     const ParametrosPQ *params) {
+  ArquivoDataset arq;
+  if (formato_abrir(arquivo, &arq) != 0) {
+    fprintf(stderr, "Falha ao abrir arquivo de treino: %s\n", arquivo);
+    return NULL;
+  }
+  // Sem treino denso: a PQ é construída lendo o arquivo em lotes
+  KnnContexto *ctx = criar(NULL, (int) arq.cab.n, (int) arq.cab.d, num_threads, 1);
+  if (!ctx) {
+    formato_fechar(&arq);
+    return NULL;
+  }
+  ctx->arquivo = strdup(arquivo);
+  if (pq_construir_arquivo(&ctx->pq, &arq, params->m, params->bits, ctx->pool) != 0) {
+    formato_fechar(&arq);
+    knn_destroy(ctx);
+    return NULL;
+  }
+  ctx->com_pq = 1;
+  ctx->rerank = params->rerank > 0 ? params->rerank : 0;
+  // O mesmo arquivo atende o re-ranqueamento
+  ctx->origem = arq;
+  ctx->com_origem = 1;
+  return ctx;
+}
+
+KnnContexto *knn_create_from_memory(const double *dados, int N, int D, int num_threads) {
+  if (N <= 0 || D <= 0) {
+    fprintf(stderr, "Erro: treino vazio (N=%d, D=%d)\n", N, D);
+    return NULL;
+  }
+  // Mesmo layout de formato_ler_pontos(): um bloco alinhado, liberado junto
+  Ponto *treino = (Ponto*) malloc(N * sizeof(Ponto));
+  void *bloco = NULL;
+  if (!treino || posix_memalign(&bloco, 64, (size_t) N * D * sizeof(double)) != 0) {
+    fprintf(stderr, "Erro de alocação de memória para o treino\n");
+    free(treino);
+    return NULL;
+  }
+  memcpy(bloco, dados, (size_t) N * D * sizeof(double));
+  for (int i = 0; i < N; i++) {
+    treino[i].features = (double*) bloco + (size_t) i * D;
+    treino[i].id = i;
+    treino[i].rotulo = -1;
+  }
+
+  KnnContexto *ctx = criar(treino, N, D, num_threads, 1);
+  if (!ctx) formato_liberar_pontos(treino, N);
+  return ctx;
+}
+
+KnnContexto *knn_create_from_points(Ponto *treino, int N, int D, int num_threads) {
+  return criar(treino, N, D, num_threads, 0);
+}
+
+int knn_configure(KnnContexto *ctx, const ConfigMotor *cfg) {
+  int ret = 0;
+  pthread_mutex_lock(&ctx->mutex);
+  if (cfg->num_threads != ctx->pool->n) {
+    if (cfg->num_threads <= 0) {
+      fprintf(stderr, "Erro: Número de threads deve ser positivo\n");
+      ret = -1;
+    } else {
+      // O pool antigo só é trocado se o novo puder ser criado
+      Pool *novo = (Pool*) malloc(sizeof(Pool));
+      if (!novo || pool_criar(novo, cfg->num_threads) != 0) {
+        fprintf(stderr, "Erro: mantendo o pool de %d threads\n", ctx->pool->n);
+        free(novo);
+        ret = -1;
+      } else {
+        pool_destruir(ctx->pool);
+        free(ctx->pool);
+        ctx->pool = novo;
+        // Os buffers por thread são refeitos na próxima consulta
+        free(ctx->ordenados);
+        ctx->ordenados = NULL;
+      }
+    }
+  }
+  if (ret == 0) ctx->cfg = *cfg;
+  pthread_mutex_unlock(&ctx->mutex);
+  return ret;
+}
+
+int knn_build_index(KnnContexto *ctx) {
+  pthread_mutex_lock(&ctx->mutex);
+  // Conferido com o mutex: um knn_build_pq concorrente pode liberar o treino
+  if (!ctx->treino) {
+    fprintf(stderr, "Erro: o contexto não tem o treino denso em memória (só a PQ)\n");
+    pthread_mutex_unlock(&ctx->mutex);
+    return -1;
+  }
+  if (ctx->com_indice) indice_normas_libera(&ctx->indice);
+  ctx->com_indice = indice_normas_construir(&ctx->indice, ctx->treino, ctx->N, ctx->D) == 0;
+  int ret = ctx->com_indice ? 0 : -1;
+  pthread_mutex_unlock(&ctx->mutex);
+  return ret;
+}
+
+static void tarefa_indice(int indice, int total, void *arg) {
+  (void) indice;
+  (void) total;
+  Lote *lote = (Lote*) arg;
+  KnnContexto *ctx = lote->ctx;
+
+  // O custo por consulta varia com as normas: distribuição dinâmica em lotes
+  for (;;) {
+    pthread_mutex_lock(&lote->mutex);
+    int q0 = lote->proxima;
+    lote->proxima += CONSULTAS_POR_LOTE;
+    pthread_mutex_unlock(&lote->mutex);
+    if (q0 >= lote->M) break;
+
+    int q1 = q0 + CONSULTAS_POR_LOTE < lote->M ? q0 + CONSULTAS_POR_LOTE : lote->M;
+    trace_inicio_faixa("lote", q0, q1);
+    for (int q = q0; q < q1; q++) {
+      indice_normas_buscar(&ctx->indice, ctx->treino, ctx->D, &lote->consultas[q],
+                           &lote->heaps[q]);
+    }
+    trace_fim("lote");
+  }
+}
+
+static void liberar_rascunhos(KnnContexto *ctx) {
+  for (int i = 0; i < ctx->n_rascunhos; i++) {
+    RascunhoPQ *r = &ctx->rascunhos[i];
+    free(r->tabela);
+    free(r->tabela_q);
+    free(r->linha);
+    free(r->bruto);
+    heap_libera(&r->candidatos);
+  }
+  free(ctx->rascunhos);
+  ctx->rascunhos = NULL;
+  ctx->n_rascunhos = 0;
+}
+
+// Garante um rascunho por thread com espaço para os candidatos de K vizinhos
+static int preparar_rascunhos(KnnContexto *ctx, int K) {
+  int candidatos = ctx->rerank > K ? ctx->rerank : K;
+  if (ctx->n_rascunhos == ctx->pool->n &&
+      ctx->rascunhos[0].candidatos.length >= candidatos) {
+    return 0;
+  }
+  liberar_rascunhos(ctx);
+
+  int n = ctx->pool->n;
+  ctx->rascunhos = (RascunhoPQ*) calloc(n, sizeof(RascunhoPQ));
+  if (!ctx->rascunhos) return -1;
+  ctx->n_rascunhos = n;
+  int erro = 0;
+  for (int i = 0; i < n; i++) {
+    RascunhoPQ *r = &ctx->rascunhos[i];
+    r->tabela = (float*) malloc(pq_tamanho_tabela(&ctx->pq.cod) * sizeof(float));
+    r->tabela_q = (uint8_t*) malloc((size_t) ctx->pq.cod.m * 16);
+    r->linha = (double*) malloc(ctx->D * sizeof(double));
+    r->bruto = (unsigned char*) malloc(ctx->com_origem ? ctx->origem.cab.passo : 1);
+    heap_init(&r->candidatos, candidatos);
+    if (!r->tabela || !r->tabela_q || !r->linha || !r->bruto || !r->candidatos.data) erro = 1;
+  }
+  if (erro) liberar_rascunhos(ctx);
+  return erro ? -1 : 0;
+}
+
+static void tarefa_pq(int indice, int total, void *arg) {
+  (void) total;
+  Lote *lote = (Lote*) arg;
+  KnnContexto *ctx = lote->ctx;
+  RascunhoPQ *r = &ctx->rascunhos[indice];
+  int candidatos = ctx->rerank > lote->K ? ctx->rerank : lote->K;
+  Ponto original = {r->linha, -1, -1};
+
+  for (;;) {
+    pthread_mutex_lock(&lote->mutex);
+    int q0 = lote->proxima;
+    lote->proxima += CONSULTAS_POR_LOTE;
+    pthread_mutex_unlock(&lote->mutex);
+    if (q0 >= lote->M) break;
+
+    int q1 = q0 + CONSULTAS_POR_LOTE < lote->M ? q0 + CONSULTAS_POR_LOTE : lote->M;
+    trace_inicio_faixa("lote", q0, q1);
+    for (int q = q0; q < q1; q++) {
+      const Ponto *consulta = &lote->consultas[q];
+      Heap *saida = &lote->heaps[q];
+      r->candidatos.n_elem = 0;
+      r->candidatos.length = candidatos;
+      pq_tabela(&ctx->pq.cod, consulta->features, r->tabela);
+      pq_varrer(&ctx->pq, r->tabela, r->tabela_q, &r->candidatos);
+
+      for (int c = 0; c < r->candidatos.n_elem; c++) {
+        int linha = r->candidatos.data[c].id;
+        double dist = r->candidatos.data[c].dist;
+        if (ctx->rerank > 0) {
+          // Distância exata, com o vetor original da memória ou do disco
+          if (ctx->treino) {
+            dist = distancia(&ctx->treino[linha], consulta, ctx->D);
+          } else if (formato_ler_linha(&ctx->origem, linha, r->bruto, r->linha) == 0) {
+            dist = distancia(&original, consulta, ctx->D);
+          } else {
+            pthread_mutex_lock(&lote->mutex);
+            lote->erro = 1;
+            pthread_mutex_unlock(&lote->mutex);
+            // A distância da PQ não pode se misturar às exatas na heap
+            continue;
+          }
+        }
+        heap_inserir(saida, dist, ctx->pq.ids[linha]);
+      }
+    }
+    trace_fim("lote");
+  }
+}
+
+int knn_build_pq(KnnContexto *ctx, const ParametrosPQ *params) {
+  pthread_mutex_lock(&ctx->mutex);
+  if (!ctx->treino) {
+    fprintf(stderr, "Erro: o contexto não tem o treino denso em memória (só a PQ)\n");
+    pthread_mutex_unlock(&ctx->mutex);
+    return -1;
+  }
+  liberar_rascunhos(ctx);
+  if (ctx->com_pq) pq_libera(&ctx->pq);
+  ctx->com_pq = pq_construir(&ctx->pq, ctx->treino, ctx->N, ctx->D, params->m,
+                             params->bits, ctx->pool) == 0;
+  ctx->rerank = params->rerank > 0 ? params->rerank : 0;
+
+  // O dataset de origem permite re-ranquear sem manter o treino denso
+  const char *arquivo = params->arquivo_original ? params->arquivo_original : ctx->arquivo;
+  if (ctx->com_pq && arquivo && !ctx->com_origem) {
+    if (formato_abrir(arquivo, &ctx->origem) == 0) {
+      ctx->com_origem = ctx->origem.cab.n == (uint64_t) ctx->N &&
+                        ctx->origem.cab.d == (uint32_t) ctx->D;
+      if (!ctx->com_origem) {
+        fprintf(stderr, "Aviso: %s não corresponde ao treino; re-ranqueamento em memória\n",
+                arquivo);
+        formato_fechar(&ctx->origem);
+      }
+    }
+  }
+  if (ctx->com_pq && ctx->com_origem && ctx->dono) {
+    formato_liberar_pontos(ctx->treino, ctx->N);
+    ctx->treino = NULL;
+  }
+  int ret = ctx->com_pq ? 0 : -1;
+  pthread_mutex_unlock(&ctx->mutex);
+  return ret;
+}
+
+int knn_set_rerank(KnnContexto *ctx, int rerank) {
+  pthread_mutex_lock(&ctx->mutex);
+  ctx->rerank = rerank > 0 ? rerank : 0;
+  pthread_mutex_unlock(&ctx->mutex);
+  return 0;
+}
+
+// Executa a busca com o mutex do contexto já adquirido
+static int consultar(KnnContexto *ctx, Ponto *consultas, int M, int K, Heap *heaps) {
+  if (K <= 0 || K > ctx->N) {
+    fprintf(stderr, "Erro: K deve estar entre 1 e %d (número de pontos de treino)\n", ctx->N);
+    return -1;
+  }
+  if (ctx->com_pq) {
+    if (preparar_rascunhos(ctx, K) != 0) {
+      fprintf(stderr, "Erro de alocação de memória para a busca pela PQ\n");
+      return -1;
+    }
+    Lote lote = {.ctx = ctx, .consultas = consultas, .heaps = heaps, .M = M, .K = K};
+    pthread_mutex_init(&lote.mutex, NULL);
+    pool_executar(ctx->pool, tarefa_pq, &lote);
+    pthread_mutex_destroy(&lote.mutex);
+    return lote.erro ? -1 : 0;
+  }
+  if (!ctx->treino) {
+    fprintf(stderr, "Erro: o contexto não tem o treino denso em memória (só a PQ)\n");
+    return -1;
+  }
+  if (ctx->com_indice) {
+    Lote lote = {.ctx = ctx, .consultas = consultas, .heaps = heaps, .M = M, .K = K};
+    pthread_mutex_init(&lote.mutex, NULL);
+    pool_executar(ctx->pool, tarefa_indice, &lote);
+    pthread_mutex_destroy(&lote.mutex);
+    return 0;
+  }
+  Dataset visao = {ctx->treino, consultas, M, ctx->N, ctx->D, K};
+  return motor_executar_pool(ctx->pool, &visao, heaps, &ctx->cfg);
+}
+
+int knn_query_points(KnnContexto *ctx, Ponto *consultas, int M, int K, Heap *heaps) {
+  pthread_mutex_lock(&ctx->mutex);
+  int ret = consultar(ctx, consultas, M, K, heaps);
+  pthread_mutex_unlock(&ctx->mutex);
+  return ret;
+}
+
+// Garante buffers para M consultas com K vizinhos
+static int reservar(KnnContexto *ctx, int M, int K) {
+  if (M > ctx->cap_consultas) {
+    Ponto *p = (Ponto*) realloc(ctx->consultas, M * sizeof(Ponto));
+    if (!p) return -1;
+    ctx->consultas = p;
+    ctx->cap_consultas = M;
+  }
+  if (M > ctx->cap_heaps || K > ctx->cap_k) {
+    for (int i = 0; i < ctx->cap_heaps; i++) heap_libera(&ctx->heaps[i]);
+    free(ctx->heaps);
+    free(ctx->ordenados);
+    ctx->ordenados = NULL;
+    int cap = M > ctx->cap_heaps ? M : ctx->cap_heaps;
+    int cap_k = K > ctx->cap_k ? K : ctx->cap_k;
+    ctx->cap_heaps = 0;
+    ctx->heaps = (Heap*) malloc(cap * sizeof(Heap));
+    if (!ctx->heaps) return -1;
+    for (int i = 0; i < cap; i++) heap_init(&ctx->heaps[i], cap_k);
+    ctx->cap_heaps = cap;
+    ctx->cap_k = cap_k;
+  }
+  if (!ctx->ordenados) {
+    ctx->ordenados = (HeapElem*) malloc((size_t) ctx->pool->n * ctx->cap_k * sizeof(HeapElem));
+    if (!ctx->ordenados) return -1;
+  }
+  return 0;
+}
+
+static void tarefa_extrair(int indice, int total, void *arg) {
+  Lote *lote = (Lote*) arg;
+  HeapElem *ordenados = lote->ctx->ordenados + (size_t) indice * lote->ctx->cap_k;
+  int q_ini = (int) ((long) lote->M * indice / total);
+  int q_fim = (int) ((long) lote->M * (indice + 1) / total);
+
+  trace_inicio_faixa("extracao", q_ini, q_fim);
+  for (int q = q_ini; q < q_fim; q++) {
+    const Heap *h = &lote->heaps[q];
+    int64_t *ids = lote->out_ids + (size_t) q * lote->K;
+    double *dists = lote->out_dists + (size_t) q * lote->K;
+    heap_extrair_ordenado(h, ordenados);
+    for (int j = 0; j < lote->K; j++) {
+      ids[j] = j < h->n_elem ? ordenados[j].id : -1;
+      dists[j] = j < h->n_elem ? ordenados[j].dist : INFINITY;
+    }
+  }
+  trace_fim("extracao");
+}
+
+int knn_query_batch(KnnContexto *ctx, const double *consultas, int M, int K,
+                    int64_t *out_ids, double *out_dists) {
+  if (M <= 0) return 0;
+  if (K <= 0 || K > ctx->N) {
+    fprintf(stderr, "Erro: K deve estar entre 1 e %d (número de pontos de treino)\n", ctx->N);
+    return -1;
+  }
+  pthread_mutex_lock(&ctx->mutex);
+  if (reservar(ctx, M, K) != 0) {
+    fprintf(stderr, "Erro de alocação de memória para o lote de consultas\n");
+    pthread_mutex_unlock(&ctx->mutex);
+    return -1;
+  }
+
+  for (int i = 0; i < M; i++) {
+    // As consultas só são lidas; a vista não copia os dados
+    ctx->consultas[i].features = (double*) consultas + (size_t) i * ctx->D;
+    ctx->consultas[i].id = i;
+    ctx->consultas[i].rotulo = -1;
+    ctx->heaps[i].n_elem = 0;
+    ctx->heaps[i].length = K;
+  }
+
+  int ret = consultar(ctx, ctx->consultas, M, K, ctx->heaps);
+  if (ret == 0) {
+    Lote lote = {.ctx = ctx, .heaps = ctx->heaps, .M = M, .K = K,
+                 .out_ids = out_ids, .out_dists = out_dists};
+    pool_executar(ctx->pool, tarefa_extrair, &lote);
+  }
+  pthread_mutex_unlock(&ctx->mutex);
+  return ret;
+}
+
+void knn_destroy(KnnContexto *ctx) {
+  if (!ctx) return;
+  pool_destruir(ctx->pool);
+  free(ctx->pool);
+  for (int i = 0; i < ctx->cap_heaps; i++) heap_libera(&ctx->heaps[i]);
+  free(ctx->heaps);
+  free(ctx->consultas);
+  free(ctx->ordenados);
+  if (ctx->com_indice) indice_normas_libera(&ctx->indice);
+  liberar_rascunhos(ctx);
+  if (ctx->com_pq) pq_libera(&ctx->pq);
+  if (ctx->com_origem) formato_fechar(&ctx->origem);
+  free(ctx->arquivo);
+  if (ctx->dono) formato_liberar_pontos(ctx->treino, ctx->N);
+  pthread_mutex_destroy(&ctx->mutex);
+  free(ctx);
+}
@@ -0,0 +1,166 @@
+/**
+ * @file libknn.h
+ * @brief API da biblioteca libknn: contexto de consultas KNN reutilizável.
+ *
+ * Um contexto guarda o treino, um pool persistente de threads e os buffers
+ * de trabalho das consultas. As threads e os buffers sobrevivem entre as
+ * chamadas, de modo que cada lote de consultas paga só o cálculo das
+ * distâncias:
+ *
+ * @code
+ * KnnContexto *ctx = knn_create_from_file("train.bin", 4);
+ * knn_build_index(ctx);                       // opcional
+ * knn_query_batch(ctx, consultas, M, K, ids, dists);
+ * knn_destroy(ctx);
+ * @endcode
+ *
+ * Chamadas concorrentes sobre o mesmo contexto são seguras: elas são
+ * serializadas e cada uma usa todas as threads do contexto. Serviços que
+ * queiram lotes realmente simultâneos devem usar um contexto por lote em voo.
+ */
+
+#ifndef LIBKNN_H
+#define LIBKNN_H
+
+#include <stdint.h>
+
+#include "heap.h"
+#include "knn.h"
+#include "motor.h"
+
+/**
+ * @brief Contexto de consultas (opaco).
+ */
+typedef struct KnnContexto KnnContexto;
+
+/**
+ * @brief Cria um contexto com o treino lido de um dataset (v2 ou legado).
+ *
+ * @details O motor inicial é o blocos, com blocos dimensionados para a L2.
+ *
+ * @param arquivo Caminho do dataset de treino.
+ * @param num_threads Número de threads do pool.
+ * @return o contexto, ou NULL em caso de erro.
+ */
+KnnContexto *knn_create_from_file(const char *arquivo, int num_threads);
+
+/**
+ * @brief Cria um contexto com uma cópia de um treino em memória.
+ *
+ * @param dados Matriz `N x D` de doubles, uma linha por ponto.
+ * @param N Número de pontos de treino; os ids são `0..N-1`.
+ * @param D Número de dimensões.
+ * @param num_threads Número de threads do pool.
+ * @return o contexto, ou NULL em caso de erro.
+ */
+KnnContexto *knn_create_from_memory(const double *dados, int N, int D, int num_threads);
+
+/**
+ * @brief Cria um contexto sobre pontos já carregados, sem copiá-los.
+ *
+ * @details Os pontos continuam pertencendo a quem chama e devem sobreviver
+ * ao contexto. É o caminho usado pelo `knn_main`.
+ *
+ * @return o contexto, ou NULL em caso de erro.
+ */
+KnnContexto *knn_create_from_points(Ponto *treino, int N, int D, int num_threads);
+
+/**
+ * @brief Troca o motor e seus parâmetros.
+ *
+ * @details Se `cfg->num_threads` for diferente do tamanho do pool, o pool é
+ * recriado com o novo número de threads. Se o novo pool não puder ser
+ * criado, o contexto continua com o pool e a configuração anteriores.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int knn_configure(KnnContexto *ctx, const ConfigMotor *cfg);
+
+/**
+ * @brief Constrói o índice por norma do treino (ver indice.h).
+ *
+ * @details Com o índice construído, as consultas passam a usá-lo no lugar do
+ * motor configurado; os vizinhos retornados são os mesmos.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int knn_build_index(KnnContexto *ctx);
+
+/**
+ * @brief Parâmetros da quantização por produto (ver pq.h).
+ */
+typedef struct {
+  int m;                        /**< Número de subespaços (divide D). */
+  int bits;                     /**< Bits por código: 4 ou 8. */
+  int rerank;                   /**< Candidatos re-ranqueados com a distância exata (0 = nenhum). */
+  const char *arquivo_original; /**< Dataset com os vetores originais (NULL = o do contexto). */
+} ParametrosPQ;
+
+/**
+ * @brief Treina a PQ e codifica o treino.
+ *
+ * @details Com a PQ construída, as consultas passam a usá-la no lugar do motor
+ * e do índice por norma, e os resultados são aproximados. Se `rerank > 0`, os
+ * `rerank` melhores candidatos da PQ são reordenados pela distância exata.
+ * Quando o contexto é dono do treino e o dataset original está disponível em
+ * disco (o arquivo de knn_create_from_file() ou `arquivo_original`), o treino
+ * denso é liberado após a codificação e o re-ranqueamento lê do disco só as
+ * linhas candidatas; a partir daí a busca exata deixa de estar disponível.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int knn_build_pq(KnnContexto *ctx, const ParametrosPQ *params);
+
+/**
+ * @brief Cria um contexto só com a PQ, sem carregar o treino denso.
+ *
+ * @details Para treinos maiores que a memória: a PQ é treinada sobre uma
+ * amostra e o treino é codificado em lotes lidos do disco (ver
+ * pq_construir_arquivo()), de modo que só os códigos ficam em memória. O
+ * re-ranqueamento lê de `arquivo` as linhas candidatas, e
+ * `params->arquivo_original` é ignorado. A busca exata e o índice por norma
+ * não ficam disponíveis.
+ *
+ * @param arquivo Dataset de treino (formato v2 ou legado).
+ * @param num_threads Número de threads do pool.
+ * @param params Parâmetros da PQ.
+ * @return O contexto, ou NULL em caso de erro.
+ */
+KnnContexto *knn_create_pq_from_file(const char *arquivo, int num_threads,
+                                     const ParametrosPQ *params);
+
+/**
+ * @brief Troca o número de candidatos re-ranqueados da PQ, sem retreinar.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int knn_set_rerank(KnnContexto *ctx, int rerank);
+
+/**
+ * @brief Busca os K vizinhos de um lote de consultas.
+ *
+ * @param ctx Contexto.
+ * @param consultas Matriz `M x D` de doubles, uma linha por consulta.
+ * @param M Número de consultas.
+ * @param K Número de vizinhos (entre 1 e N).
+ * @param out_ids Vetor de `M * K` ids, ordenados por distância em cada consulta.
+ * @param out_dists Vetor de `M * K` distâncias correspondentes.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int knn_query_batch(KnnContexto *ctx, const double *consultas, int M, int K,
+                    int64_t *out_ids, double *out_dists);
+
+/**
+ * @brief Busca os K vizinhos de pontos já carregados, preenchendo heaps.
+ *
+ * @param heaps Vetor de `M` heaps vazias com capacidade K.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int knn_query_points(KnnContexto *ctx, Ponto *consultas, int M, int K, Heap *heaps);
+
+/**
+ * @brief Encerra as threads e libera o contexto.
+ */
+void knn_destroy(KnnContexto *ctx);
+
+#endif // !LIBKNN_H
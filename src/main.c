@@ -14,260 +14,279 @@
 #include <sys/time.h>
 #include <time.h>
 
+#include "ajuste.h"
+#include "autojuncao.h"
+#include "dataset.h"
+#include "esparso.h"
+#include "formato.h"
 #include "heap.h"
+#include "indice.h"
 #include "knn.h"
+#include "libknn.h"
+#include "motor.h"
+#include "parcial.h"
+#include "raio.h"
+#include "trace.h"
 #include "utils.h"
 
 /**
- * @brief Lê um dataset binário de um arquivo
- *
- * @param filename Nome do arquivo binário
- * @param pontos Array de pontos a ser preenchido
- * @param n_pontos Número de pontos no dataset
- * @param dimensoes Número de dimensões de cada ponto
- * @return 0 em caso de sucesso, -1 em caso de erro
+ * @brief Opções de linha de comando posteriores aos argumentos obrigatórios
  */
-int ler_pontos(FILE *file, Ponto *pontos, int *n_pontos, int *dimensoes) {
-  for (int i = 0; i < *n_pontos; i++) {
-    pontos[i].features = (double*) malloc(*dimensoes * sizeof(double));
-    if (!pontos[i].features) {
-      fprintf(stderr, "Erro de alocação de memória para features do ponto %d\n",
-              i);
-      return -1;
-    }
-
-    pontos[i].id = i; // Atribui ID sequencial
-
-    // Lê as features do ponto (assumindo que o arquivo contém doubles)
-    for (int j = 0; j < *dimensoes; j++) {
-      double value;
-      if (fread(&value, sizeof(double), 1, file) != 1) {
-        fprintf(stderr, "Erro ao ler feature %d do ponto %d\n", j, i);
-        return -1;
-      }
-      pontos[i].features[j] = value;
-    }
-  }
+typedef struct {
+  const char *saida;    /**< Arquivo texto de saída (NULL se omitido). */
+  int shard_ini;        /**< Primeira linha de treino do shard (-1 = todas). */
+  int shard_fim;        /**< Linha seguinte à última do shard. */
+  const char *parcial;  /**< Arquivo de resultados parciais (ou NULL). */
+  int autojuncao;       /**< 1 para o grafo KNN do próprio treino. */
+  double raio;          /**< Raio da busca por raio (negativo = KNN). */
+  int max_resultados;   /**< Limite de vizinhos por consulta no raio (0 = sem limite). */
+  const char *csr;      /**< Arquivo CSR binário da busca por raio (ou NULL). */
+  TipoMotor motor;      /**< Motor da busca KNN. */
+  int automatico;       /**< 1 para escolher motor e threads por medição. */
+  int indice;           /**< 1 para buscar pelo índice por norma. */
+  int pq;               /**< Subespaços da quantização por produto (0 = sem PQ). */
+  int pq_bits;          /**< Bits por código da PQ (4 ou 8). */
+  int rerank;           /**< Candidatos da PQ re-ranqueados pela distância exata. */
+  const char *arquivo_ajuste; /**< Arquivo com as configurações já ajustadas. */
+  const char *trace;    /**< Arquivo JSON da linha do tempo das threads (ou NULL). */
+  MetricaEsparsa metrica; /**< Métrica da busca com treino esparso. */
+} Opcoes;
 
-  return 0;
+/**
+ * @brief Exibe as estatísticas de execução
+ *
+ * @param tempo_leitura Tempo gasto na leitura dos dados (em segundos)
+ * @param tempo_processamento Tempo gasto no processamento paralelo (em
+ * segundos)
+ * @param tempo_total Tempo total de execução (em segundos)
+ * @param num_threads Número de threads utilizadas
+ */
+void exibir_estatisticas(double tempo_leitura, double tempo_processamento,
+                         double tempo_total, int num_threads) {
+  printf("\n=== ESTATÍSTICAS DE EXECUÇÃO ===\n");
+  printf("Tempo de leitura dos dados: %.6f segundos\n", tempo_leitura);
+  printf("Tempo de processamento paralelo: %.6f segundos\n",
+         tempo_processamento);
+  printf("Tempo total de execução: %.6f segundos\n", tempo_total);
+  printf("Número de threads utilizadas: %d\n", num_threads);
+  printf("===============================\n");
 }
 
-int ler_metadados(FILE *file, int *n_pontos, int *dim) {
-  if (fread(n_pontos, sizeof(int), 1, file) != 1) {
-    fprintf(stderr, "Erro na leitura na quantidade de pontos do arquivo\n");
-    return -1;
-  }
-  if (fread(dim, sizeof(int), 1, file) != 1) {
-    fprintf(stderr, "Erro na leitura na dimensão dos pontos do arquivo\n");
-    return -1;
-  }
-  return 0;
+/**
+ * @brief Calcula a diferença de tempo entre dois timevals
+ *
+ * @param start Tempo inicial
+ * @param end Tempo final
+ * @return Diferença em segundos
+ */
+double calcular_tempo(struct timeval start, struct timeval end) {
+  return (end.tv_sec - start.tv_sec) +
+         (end.tv_usec - start.tv_usec) / 1000000.0;
 }
 
 /**
- * @brief Inicializa o dataset com dados de treino e teste
+ * @brief Executa a busca por raio, salva os resultados e exibe as estatísticas
+ *
+ * @param dataset Dataset carregado
+ * @param op Opções da linha de comando
+ * @param num_threads Número de threads
+ * @param tempo_leitura Tempo gasto na leitura dos dados (em segundos)
+ * @param inicio_total Instante de início da execução
+ * @return 0 em caso de sucesso, 1 em caso de erro
  */
-int inicializar_dataset(Dataset *dataset, const char *arquivo_treino,
-                        const char *arquivo_teste, int K) {
-
-  dataset->K = K;
-
-  FILE *file_treino = fopen(arquivo_treino, "rb");
-  FILE *file_teste = fopen(arquivo_teste, "rb");
-
-  if (!file_treino) {
-    fprintf(stderr, "Erro ao abrir arquivo de treino: %s\n", arquivo_treino);
-    return -1;
-  }
-  if (!file_teste) {
-    fprintf(stderr, "Erro ao abrir arquivo de teste: %s\n", arquivo_teste);
-    fclose(file_treino);
-    return -1;
-  }
+int executar_modo_raio(Dataset *dataset, const Opcoes *op, int num_threads,
+                       double tempo_leitura, struct timeval inicio_total) {
+  struct timeval inicio_processamento, fim_processamento, fim_total;
+  ResultadoRaio res;
 
-  // Lê metadados dos arquivos
-  int dim_treino, dim_teste;
-
-  if (ler_metadados(file_treino, &dataset->N, &dim_treino) != 0) {
-    fprintf(stderr, "Falha ao ler metadados do arquivo de treino\n");
-    fclose(file_treino);
-    fclose(file_teste);
-    return -1;
-  }
-
-  if (ler_metadados(file_teste, &dataset->M, &dim_teste) != 0) {
-    fprintf(stderr, "Falha ao ler metadados do arquivo de teste\n");
-    fclose(file_treino);
-    fclose(file_teste);
-    return -1;
-  }
-
-  // Verifica se as dimensões são compatíveis
-  if (dim_treino != dim_teste) {
-    fprintf(stderr, "Erro: Dimensões incompatíveis - treino: %d, teste: %d\n",
-            dim_treino, dim_teste);
-    fclose(file_treino);
-    fclose(file_teste);
-    return -1;
-  }
-
-  dataset->D = dim_treino;
-
-  // Valida K
-  if (K <= 0 || K > dataset->N) {
-    fprintf(stderr, "Erro: K deve estar entre 1 e %d (número de pontos de treino)\n", dataset->N);
-    fclose(file_treino);
-    fclose(file_teste);
-    return -1;
-  }
-
-  // Aloca memória para os arrays de pontos
-  dataset->treino = (Ponto*) malloc(dataset->N * sizeof(Ponto));
-  dataset->teste = (Ponto*) malloc(dataset->M * sizeof(Ponto));
-
-  if (!dataset->treino || !dataset->teste) {
-    fprintf(stderr, "Erro de alocação de memória para datasets\n");
-    fclose(file_treino);
-    fclose(file_teste);
-    return -1;
-  }
-
-  // Lê os datasets dos arquivos
-  printf("Lendo dataset de treino...\n");
-  if (ler_pontos(file_treino, dataset->treino, &dataset->N, &dataset->D) != 0) {
-    fclose(file_treino);
-    fclose(file_teste);
-    return -1;
+  gettimeofday(&inicio_processamento, NULL);
+  IndiceNormas indice;
+  if (op->indice) {
+    printf("Construindo índice por norma...\n");
+    trace_inicio("indice");
+    int ret = indice_normas_construir(&indice, dataset->treino, dataset->N, dataset->D);
+    trace_fim("indice");
+    if (ret != 0) return 1;
   }
 
-  printf("Lendo dataset de teste...\n");
-  if (ler_pontos(file_teste, dataset->teste, &dataset->M, &dataset->D) != 0) {
-    fclose(file_treino);
-    fclose(file_teste);
-    return -1;
-  }
+  printf("Iniciando busca por raio (r=%.6f) com %d threads%s...\n", op->raio, num_threads,
+         op->indice ? " (índice por norma)" : "");
+  trace_inicio("busca");
+  int erro = raio_executar(dataset, op->indice ? &indice : NULL, op->raio,
+                           op->max_resultados, num_threads, &res);
+  if (op->indice) indice_normas_libera(&indice);
+  trace_fim("busca");
+  if (erro != 0) return 1;
+  gettimeofday(&fim_processamento, NULL);
 
-  fclose(file_treino);
-  fclose(file_teste);
+  printf("Busca por raio concluída! %lld vizinhos encontrados\n", (long long) res.total);
+  printf("Salvando resultados...\n");
+  trace_inicio("saida");
+  int ret = raio_salvar_texto(&res, op->saida ? op->saida : "output.txt");
+  if (op->csr && raio_salvar_csr(&res, op->max_resultados, op->csr) != 0) ret = -1;
+  trace_fim("saida");
 
-  printf("Datasets carregados com sucesso!\n");
-  printf("Treino: %d pontos, Teste: %d pontos, Dimensões: %d, K: %d\n",
-         dataset->N, dataset->M, dataset->D, dataset->K);
+  gettimeofday(&fim_total, NULL);
+  exibir_estatisticas(tempo_leitura, calcular_tempo(inicio_processamento, fim_processamento),
+                      calcular_tempo(inicio_total, fim_total), num_threads);
+  raio_libera(&res);
+  if (ret != 0) return 1;
 
+  printf("\n=== EXECUÇÃO CONCLUÍDA COM SUCESSO ===\n");
   return 0;
 }
 
 /**
- * @brief Inicializa as heaps para cada ponto de teste
+ * @brief Lê as consultas da busca esparsa, no formato esparso ou denso
  *
- * @param heaps Array de heaps
- * @param M Número de pontos de teste (número de heaps)
- * @param K Capacidade de cada heap
  * @return 0 em caso de sucesso, -1 em caso de erro
  */
-int inicializar_heaps(Heap *heaps, int M, int K) {
-  for (int i = 0; i < M; i++) {
-    heap_init(&heaps[i], K);
+int ler_consultas_esparsa(const char *arquivo, int esparso, int D, MatrizEsparsa *teste,
+                          Ponto **teste_denso, int *M) {
+  if (esparso) {
+    printf("Lendo dataset de teste (esparso)...\n");
+    if (esparso_ler(arquivo, teste) != 0) return -1;
+    *M = teste->n;
+    if (teste->d != D) {
+      fprintf(stderr, "Erro: Dimensões incompatíveis - treino: %d, teste: %d\n", D, teste->d);
+      esparso_libera(teste);
+      return -1;
+    }
+    return 0;
   }
-  return 0;
-}
 
-/**
- * @brief Libera a memória das heaps
- *
- * @param heaps Array de heaps
- * @param M Número de heaps
- */
-void liberar_heaps(Heap *heaps, int M) {
-  for (int i = 0; i < M; i++) {
-    heap_libera(&heaps[i]);
+  ArquivoDataset arq;
+  if (formato_abrir(arquivo, &arq) != 0) {
+    fprintf(stderr, "Falha ao abrir arquivo de teste: %s\n", arquivo);
+    return -1;
+  }
+  *M = (int) arq.cab.n;
+  int ret = 0;
+  if (arq.cab.d != (uint32_t) D) {
+    fprintf(stderr, "Erro: Dimensões incompatíveis - treino: %d, teste: %u\n", D, arq.cab.d);
+    ret = -1;
+  } else {
+    printf("Lendo dataset de teste (%s, %s)...\n", arq.legado ? "legado" : "v2",
+           dtype_nome((DType) arq.cab.dtype));
+    ret = formato_ler_pontos(&arq, 0, *M, teste_denso);
   }
+  formato_fechar(&arq);
+  return ret;
 }
 
 /**
- * @brief Libera a memória do dataset
+ * @brief Executa a busca KNN com treino esparso, salva os resultados e exibe
+ * as estatísticas
  *
- * @param dataset Ponteiro para a estrutura Dataset
+ * @details O teste pode estar no formato esparso ou denso (v2 ou legado);
+ * o formato de cada arquivo é detectado automaticamente.
+ *
+ * @return 0 em caso de sucesso, 1 em caso de erro
  */
-void liberar_dataset(Dataset *dataset) {
-  if (dataset->treino) {
-    for (int i = 0; i < dataset->N; i++) {
-      free(dataset->treino[i].features);
-    }
-    free(dataset->treino);
-  }
+int executar_modo_esparso(const char *arquivo_treino, const char *arquivo_teste, int K,
+                          int num_threads, const Opcoes *op, struct timeval inicio_total) {
+  struct timeval inicio_leitura, fim_leitura, inicio_processamento, fim_processamento;
+  struct timeval fim_total;
+  MatrizEsparsa treino, teste;
+  Ponto *teste_denso = NULL;
+  int M = 0;
 
-  if (dataset->teste) {
-    for (int i = 0; i < dataset->M; i++) {
-      free(dataset->teste[i].features);
-    }
-    free(dataset->teste);
+  int teste_esparso = esparso_detectar(arquivo_teste);
+  if (teste_esparso < 0) return 1;
+
+  gettimeofday(&inicio_leitura, NULL);
+  trace_inicio("leitura");
+  printf("Lendo dataset de treino (esparso)...\n");
+  if (esparso_ler(arquivo_treino, &treino) != 0) {
+    trace_fim("leitura");
+    return 1;
+  }
+  int erro = ler_consultas_esparsa(arquivo_teste, teste_esparso, treino.d, &teste,
+                                   &teste_denso, &M);
+  trace_fim("leitura");
+  if (erro != 0) {
+    esparso_libera(&treino);
+    return 1;
   }
-}
 
-/**
- * @brief Salva os resultados em um arquivo
- *
- * @param heaps Array de heaps com os resultados
- * @param M Número de pontos de teste
- * @param K Número de vizinhos mais próximos
- * @param filename Nome do arquivo de saída
- */
-void salvar_resultados(Heap *heaps, int M, int K, const char *filename) {
-  FILE *file = fopen(filename, "w");
-  if (!file) {
-    fprintf(stderr, "Erro ao criar arquivo de saída %s\n", filename);
-    return;
+  int ret = 0;
+  if (K <= 0 || K > treino.n) {
+    fprintf(stderr, "Erro: K deve estar entre 1 e %d (número de pontos de treino)\n", treino.n);
+    ret = 1;
+  } else {
+    printf("Datasets carregados com sucesso!\n");
+    printf("Treino: %d pontos (%lld não nulos, densidade %.4f%%), Teste: %d pontos (%s), "
+           "Dimensões: %d, K: %d\n", treino.n, (long long) treino.nnz,
+           treino.n > 0 ? 100.0 * treino.nnz / ((double) treino.n * treino.d) : 0.0,
+           M, teste_esparso ? "esparso" : "denso", treino.d, K);
   }
 
-  fprintf(file, "Resultados do KNN (K=%d)\n", K);
-  fprintf(file, "==============================\n\n");
+  trace_inicio("heaps");
+  Heap *heaps = ret == 0 ? (Heap*) malloc((M > 0 ? M : 1) * sizeof(Heap)) : NULL;
+  if (ret == 0 && !heaps) {
+    fprintf(stderr, "Erro de alocação de memória para heaps\n");
+    ret = 1;
+  }
+  if (ret == 0) inicializar_heaps(heaps, M, K);
+  trace_fim("heaps");
+  gettimeofday(&fim_leitura, NULL);
 
-  for (int i = 0; i < M; i++) {
-    fprintf(file, "Ponto de teste %d:\n", i);
-    fprintf(file, "K-vizinhos mais próximos:\n");
+  if (ret == 0) {
+    printf("Iniciando busca esparsa com %d threads (consultas %s, %s)...\n", num_threads,
+           teste_esparso ? "esparsas" : "densas",
+           op->metrica == ESPARSO_PRODUTO ? "maior produto interno" : "distância euclidiana");
+    gettimeofday(&inicio_processamento, NULL);
+    trace_inicio("busca");
+    if (esparso_buscar(&treino, teste_esparso ? &teste : NULL, teste_denso, M, op->metrica,
+                       heaps, num_threads) != 0) {
+      ret = 1;
+    }
+    trace_fim("busca");
+    gettimeofday(&fim_processamento, NULL);
+  }
 
-    for (int j = 0; j < heaps[i].n_elem; j++) {
-      fprintf(file, "  ID: %d, Distância: %.6f\n", heaps[i].data[j].id,
-              heaps[i].data[j].dist);
+  if (ret == 0) {
+    printf("Salvando resultados...\n");
+    trace_inicio("saida");
+    salvar_resultados(heaps, M, K, op->saida ? op->saida : "output.txt");
+    if (op->parcial) {
+      if (parcial_escrever_heaps(op->parcial, heaps, M, K, 0, treino.n) == 0) {
+        printf("Resultados parciais (treino [0, %d)) salvos em %s\n", treino.n, op->parcial);
+      } else {
+        ret = 1;
+      }
     }
-    fprintf(file, "\n");
+    trace_fim("saida");
+
+    gettimeofday(&fim_total, NULL);
+    exibir_estatisticas(calcular_tempo(inicio_leitura, fim_leitura),
+                        calcular_tempo(inicio_processamento, fim_processamento),
+                        calcular_tempo(inicio_total, fim_total), num_threads);
   }
 
-  fclose(file);
-  printf("Resultados salvos em %s\n", filename);
-}
+  if (heaps) {
+    liberar_heaps(heaps, M);
+    free(heaps);
+  }
+  esparso_libera(&treino);
+  if (teste_esparso) {
+    esparso_libera(&teste);
+  } else {
+    formato_liberar_pontos(teste_denso, M);
+  }
+  if (ret != 0) return 1;
 
-/**
- * @brief Exibe as estatísticas de execução
- *
- * @param tempo_leitura Tempo gasto na leitura dos dados (em segundos)
- * @param tempo_processamento Tempo gasto no processamento paralelo (em
- * segundos)
- * @param tempo_total Tempo total de execução (em segundos)
- * @param num_threads Número de threads utilizadas
- */
-void exibir_estatisticas(double tempo_leitura, double tempo_processamento,
-                         double tempo_total, int num_threads) {
-  printf("\n=== ESTATÍSTICAS DE EXECUÇÃO ===\n");
-  printf("Tempo de leitura dos dados: %.6f segundos\n", tempo_leitura);
-  printf("Tempo de processamento paralelo: %.6f segundos\n",
-         tempo_processamento);
-  printf("Tempo total de execução: %.6f segundos\n", tempo_total);
-  printf("Número de threads utilizadas: %d\n", num_threads);
-  printf("===============================\n");
+  printf("\n=== EXECUÇÃO CONCLUÍDA COM SUCESSO ===\n");
+  return 0;
 }
 
 /**
- * @brief Calcula a diferença de tempo entre dois timevals
- *
- * @param start Tempo inicial
- * @param end Tempo final
- * @return Diferença em segundos
+ * @brief Grava e desliga o tracer, se `--trace` foi pedido
  */
-double calcular_tempo(struct timeval start, struct timeval end) {
-  return (end.tv_sec - start.tv_sec) +
-         (end.tv_usec - start.tv_usec) / 1000000.0;
+void gravar_trace(const Opcoes *op) {
+  if (!op->trace) return;
+  trace_gravar(op->trace);
+  trace_encerrar();
 }
 
 /**
@@ -327,35 +346,179 @@ void debug_completo(Dataset *dataset, Heap *heaps) {
 }
 
 /**
- * @brief Função principal
+ * @brief Exibe a mensagem de uso do programa
  */
-int main(int argc, char *argv[]) {
-  if (argc < 5) {
-    fprintf(stderr, "Uso: %s <arquivo_treino> <arquivo_teste> <K> <N_THREADS>\n", argv[0]);
-    fprintf(stderr, "  arquivo_treino: arquivo binário com dados de treino\n");
-    fprintf(stderr, "  arquivo_teste: arquivo binário com dados de teste\n");
-    fprintf(stderr, "  K: número de vizinhos mais próximos\n");
-    fprintf(stderr, "  N_THREADS: número de threads a serem usadas\n");
-    fprintf(stderr, "Exemplo: %s train.bin test.bin 3 4\n", argv[0]);
-    return 1;
-  }
-
-  // Parse dos argumentos
-  const char *arquivo_treino = argv[1];
-  const char *arquivo_teste = argv[2];
-  int K = atoi(argv[3]);
-  int num_threads = atoi(argv[4]);
+void exibir_uso(const char *programa) {
+  fprintf(stderr, "Uso: %s <arquivo_treino> <arquivo_teste> <K> <N_THREADS> [saida] [opções]\n", programa);
+  fprintf(stderr, "  arquivo_treino: arquivo binário com dados de treino\n");
+  fprintf(stderr, "  arquivo_teste: arquivo binário com dados de teste\n");
+  fprintf(stderr, "  K: número de vizinhos mais próximos\n");
+  fprintf(stderr, "  N_THREADS: número de threads a serem usadas (ignorado com --auto)\n");
+  fprintf(stderr, "  saida: arquivo texto de resultados (padrão: output.txt)\n");
+  fprintf(stderr, "Opções:\n");
+  fprintf(stderr, "  --shard <a> <b>: processa apenas as linhas de treino [a, b)\n");
+  fprintf(stderr, "  --parcial <arquivo>: grava o top-K parcial em formato binário\n");
+  fprintf(stderr, "  --self: grafo KNN do próprio treino (arquivo_teste é ignorado)\n");
+  fprintf(stderr, "  --raio <r>: todos os pontos de treino a distância <= r (K é ignorado)\n");
+  fprintf(stderr, "  --max-resultados <C>: mantém só os C mais próximos no modo --raio\n");
+  fprintf(stderr, "  --csr <arquivo>: grava o resultado do modo --raio em CSR binário\n");
+  fprintf(stderr, "  --motor <fatias|blocos>: motor da busca KNN (padrão: fatias)\n");
+  fprintf(stderr, "  --auto: escolhe motor, threads e blocos medindo uma amostra\n");
+  fprintf(stderr, "  --indice: busca exata (KNN ou --raio) pelo índice de normas do treino\n");
+  fprintf(stderr, "  --pq <m>: busca aproximada por quantização por produto com m subespaços\n");
+  fprintf(stderr, "  --pq-bits <4|8>: bits por código da PQ (padrão: 8)\n");
+  fprintf(stderr, "  --rerank <R>: re-ranqueia os R melhores candidatos da PQ lendo o treino do disco\n");
+  fprintf(stderr, "  --tuning <arquivo>: arquivo de configurações do --auto (padrão: %s)\n",
+          AJUSTE_ARQUIVO_PADRAO);
+  fprintf(stderr, "  --trace <arquivo.json>: grava a linha do tempo das threads (Chrome/Perfetto)\n");
+  fprintf(stderr, "  --metrica <euclidiana|produto>: métrica da busca com treino esparso\n");
+  fprintf(stderr, "Exemplo: %s train.bin test.bin 3 4\n", programa);
+}
 
-  // Validação básica dos parâmetros
-  if (K <= 0) {
-    fprintf(stderr, "Erro: K deve ser positivo\n");
-    return 1;
+/**
+ * @brief Lê as opções a partir de `argv[5]`
+ *
+ * @return 0 em caso de sucesso, -1 em caso de opção inválida
+ */
+int ler_opcoes(int argc, char *argv[], Opcoes *op) {
+  op->saida = NULL;
+  op->shard_ini = -1;
+  op->shard_fim = -1;
+  op->parcial = NULL;
+  op->autojuncao = 0;
+  op->raio = -1;
+  op->max_resultados = 0;
+  op->csr = NULL;
+  op->motor = MOTOR_FATIAS;
+  op->automatico = 0;
+  op->indice = 0;
+  op->pq = 0;
+  op->pq_bits = 8;
+  op->rerank = 0;
+  op->arquivo_ajuste = AJUSTE_ARQUIVO_PADRAO;
+  op->trace = NULL;
+  op->metrica = ESPARSO_EUCLIDIANA;
+  int motor_explicito = 0;
+
+  int i = 5;
+  if (i < argc && strncmp(argv[i], "--", 2) != 0) {
+    op->saida = argv[i++];
   }
-  if (num_threads <= 0) {
-    fprintf(stderr, "Erro: Número de threads deve ser positivo\n");
-    return 1;
+  for (; i < argc; i++) {
+    if (strcmp(argv[i], "--shard") == 0 && i + 2 < argc) {
+      op->shard_ini = atoi(argv[++i]);
+      op->shard_fim = atoi(argv[++i]);
+      if (op->shard_ini < 0 || op->shard_fim < op->shard_ini) {
+        fprintf(stderr, "Erro: shard inválido [%d, %d)\n", op->shard_ini, op->shard_fim);
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--parcial") == 0 && i + 1 < argc) {
+      op->parcial = argv[++i];
+    } else if (strcmp(argv[i], "--self") == 0) {
+      op->autojuncao = 1;
+    } else if (strcmp(argv[i], "--raio") == 0 && i + 1 < argc) {
+      op->raio = atof(argv[++i]);
+      if (op->raio < 0) {
+        fprintf(stderr, "Erro: o raio deve ser não negativo\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--max-resultados") == 0 && i + 1 < argc) {
+      op->max_resultados = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--csr") == 0 && i + 1 < argc) {
+      op->csr = argv[++i];
+    } else if (strcmp(argv[i], "--motor") == 0 && i + 1 < argc) {
+      int motor = motor_de_nome(argv[++i]);
+      if (motor < 0) {
+        fprintf(stderr, "Erro: motor desconhecido '%s'\n", argv[i]);
+        return -1;
+      }
+      op->motor = (TipoMotor) motor;
+      motor_explicito = 1;
+    } else if (strcmp(argv[i], "--auto") == 0) {
+      op->automatico = 1;
+    } else if (strcmp(argv[i], "--indice") == 0) {
+      op->indice = 1;
+    } else if (strcmp(argv[i], "--pq") == 0 && i + 1 < argc) {
+      op->pq = atoi(argv[++i]);
+      if (op->pq <= 0) {
+        fprintf(stderr, "Erro: o número de subespaços da PQ deve ser positivo\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--pq-bits") == 0 && i + 1 < argc) {
+      op->pq_bits = atoi(argv[++i]);
+      if (op->pq_bits != 4 && op->pq_bits != 8) {
+        fprintf(stderr, "Erro: --pq-bits deve ser 4 ou 8\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--rerank") == 0 && i + 1 < argc) {
+      op->rerank = atoi(argv[++i]);
+      if (op->rerank < 0) {
+        fprintf(stderr, "Erro: --rerank deve ser não negativo\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--tuning") == 0 && i + 1 < argc) {
+      op->arquivo_ajuste = argv[++i];
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      op->trace = argv[++i];
+    } else if (strcmp(argv[i], "--metrica") == 0 && i + 1 < argc) {
+      i++;
+      if (strcmp(argv[i], "euclidiana") == 0) {
+        op->metrica = ESPARSO_EUCLIDIANA;
+      } else if (strcmp(argv[i], "produto") == 0) {
+        op->metrica = ESPARSO_PRODUTO;
+      } else {
+        fprintf(stderr, "Erro: métrica desconhecida: %s (use euclidiana ou produto)\n", argv[i]);
+        return -1;
+      }
+    } else {
+      fprintf(stderr, "Erro: opção desconhecida ou incompleta: %s\n", argv[i]);
+      return -1;
+    }
+  }
+  if (op->autojuncao && op->shard_ini >= 0) {
+    fprintf(stderr, "Erro: --self não pode ser combinado com --shard\n");
+    return -1;
+  }
+  if (op->raio >= 0 && (op->autojuncao || op->parcial)) {
+    fprintf(stderr, "Erro: --raio não pode ser combinado com --self ou --parcial\n");
+    return -1;
   }
+  if ((op->automatico || motor_explicito) && (op->autojuncao || op->raio >= 0)) {
+    fprintf(stderr, "Erro: --auto e --motor só se aplicam à busca KNN\n");
+    return -1;
+  }
+  if (op->automatico && motor_explicito) {
+    fprintf(stderr, "Erro: --auto e --motor são mutuamente exclusivos\n");
+    return -1;
+  }
+  if (op->indice && (op->automatico || motor_explicito || op->autojuncao)) {
+    fprintf(stderr, "Erro: --indice não pode ser combinado com --auto, --motor ou --self\n");
+    return -1;
+  }
+  if (op->pq && (op->automatico || motor_explicito || op->autojuncao || op->raio >= 0 ||
+                 op->indice || op->shard_ini >= 0)) {
+    fprintf(stderr, "Erro: --pq não pode ser combinado com --auto, --motor, --self, --raio, "
+                    "--indice ou --shard\n");
+    return -1;
+  }
+  if (!op->pq && (op->pq_bits != 8 || op->rerank)) {
+    fprintf(stderr, "Erro: --pq-bits e --rerank exigem --pq\n");
+    return -1;
+  }
+  if (op->raio < 0 && (op->max_resultados || op->csr)) {
+    fprintf(stderr, "Erro: --max-resultados e --csr exigem --raio\n");
+    return -1;
+  }
+  return 0;
+}
 
+/**
+ * @brief Executa a leitura, a busca e a saída no modo pedido pelas opções
+ *
+ * @return 0 em caso de sucesso, 1 em caso de erro
+ */
+int executar_knn(const char *arquivo_treino, const char *arquivo_teste, int K,
+                 int num_threads, const Opcoes *opcoes) {
   // Variáveis para medição de tempo
   struct timeval inicio_total, fim_total, inicio_leitura, fim_leitura;
   struct timeval inicio_processamento, fim_processamento;
@@ -364,23 +527,70 @@ int main(int argc, char *argv[]) {
 
   printf("=== INICIANDO EXECUÇÃO DO KNN CONCORRENTE ===\n");
 
+  // Treino esparso (CSR): caminho próprio, com kernels esparsos
+  int treino_esparso = esparso_detectar(arquivo_treino);
+  if (treino_esparso < 0) return 1;
+  if (treino_esparso) {
+    if (opcoes->shard_ini >= 0 || opcoes->autojuncao || opcoes->raio >= 0 || opcoes->automatico ||
+        opcoes->motor != MOTOR_FATIAS || opcoes->indice || opcoes->pq) {
+      fprintf(stderr, "Erro: com treino esparso só se aplicam saida, --parcial, --trace e "
+                      "--metrica\n");
+      return 1;
+    }
+    int ret = executar_modo_esparso(arquivo_treino, arquivo_teste, K, num_threads, opcoes,
+                                    inicio_total);
+    return ret;
+  }
+  if (opcoes->metrica != ESPARSO_EUCLIDIANA) {
+    fprintf(stderr, "Erro: --metrica produto exige treino esparso\n");
+    return 1;
+  }
+  if (!opcoes->autojuncao && esparso_detectar(arquivo_teste) == 1) {
+    fprintf(stderr, "Erro: teste esparso exige treino esparso "
+                    "(converta o treino com knn_convert ... esparso)\n");
+    return 1;
+  }
+
   // 1. LEITURA E INICIALIZAÇÃO DOS DADOS
   gettimeofday(&inicio_leitura, NULL);
+  trace_inicio("leitura");
 
   Dataset dataset;
-  if (inicializar_dataset(&dataset, arquivo_treino, arquivo_teste, K) != 0) {
+  // Com a PQ o treino é lido e codificado pelo contexto (ver abaixo)
+  int erro_leitura;
+  if (opcoes->autojuncao) {
+    erro_leitura = inicializar_autojuncao(&dataset, arquivo_treino, K);
+  } else if (opcoes->pq) {
+    erro_leitura = inicializar_consultas(&dataset, arquivo_treino, arquivo_teste, K);
+  } else {
+    erro_leitura = inicializar_dataset(&dataset, arquivo_treino, arquivo_teste, K,
+                                       opcoes->shard_ini, opcoes->shard_fim);
+  }
+  if (erro_leitura != 0) {
     fprintf(stderr, "Erro na inicialização do dataset\n");
+    trace_fim("leitura");
     return 1;
   }
+  trace_fim("leitura");
+
+  if (opcoes->raio >= 0) {
+    gettimeofday(&fim_leitura, NULL);
+    int ret = executar_modo_raio(&dataset, opcoes, num_threads,
+                                 calcular_tempo(inicio_leitura, fim_leitura), inicio_total);
+    liberar_dataset(&dataset);
+    return ret;
+  }
 
   int N = dataset.N;
   int M = dataset.M;
 
   // Inicializar heaps para cada ponto de teste
+  trace_inicio("heaps");
   Heap *heaps = (Heap*) malloc(M * sizeof(Heap));
   if (!heaps) {
     fprintf(stderr, "Erro de alocação de memória para heaps\n");
     liberar_dataset(&dataset);
+    trace_fim("heaps");
     return 1;
   }
 
@@ -388,87 +598,140 @@ int main(int argc, char *argv[]) {
     fprintf(stderr, "Erro na inicialização das heaps\n");
     free(heaps);
     liberar_dataset(&dataset);
+    trace_fim("heaps");
     return 1;
   }
+  trace_fim("heaps");
 
   gettimeofday(&fim_leitura, NULL);
 
+  // Escolha do motor: por medição (--auto) ou pela linha de comando
+  ConfigMotor cfg = {opcoes->motor, num_threads, 0, 0};
+  if (opcoes->automatico) {
+    struct timeval inicio_ajuste, fim_ajuste;
+    gettimeofday(&inicio_ajuste, NULL);
+    trace_inicio("ajuste");
+    if (ajuste_automatico(&dataset, opcoes->arquivo_ajuste, &cfg) != 0) {
+      liberar_heaps(heaps, M);
+      free(heaps);
+      liberar_dataset(&dataset);
+      trace_fim("ajuste");
+      return 1;
+    }
+    trace_fim("ajuste");
+    gettimeofday(&fim_ajuste, NULL);
+    num_threads = cfg.num_threads;
+    printf("Tempo de ajuste: %.6f segundos\n", calcular_tempo(inicio_ajuste, fim_ajuste));
+  } else if (cfg.tipo == MOTOR_BLOCOS) {
+    Topologia topo;
+    ajuste_detectar_topologia(&topo);
+    motor_blocos_padrao(&cfg, dataset.D, topo.cache_l2);
+  }
+
   // Debug das primeiras distâncias
 #ifdef DEBUG
-  debug_completo(&dataset, heaps);
+  if (dataset.treino) debug_completo(&dataset, heaps);
 #endif
   // 2. CONFIGURAÇÃO DA EXECUÇÃO PARALELA
   gettimeofday(&inicio_processamento, NULL);
+  trace_inicio("busca");
 
-  // Determina o número de threads (pode ser configurável)
-  // int num_threads = 4; // Valor padrão, pode ser passado como parâmetro
-  // if (num_threads > N) {
-  //   num_threads = N; // Não faz sentido ter mais threads que pontos de treino
-  // }
-
-  printf("Iniciando processamento paralelo com %d threads...\n", num_threads);
-
-  // Criar arrays para threads e argumentos
-  pthread_t *threads = (pthread_t*) malloc(num_threads * sizeof(pthread_t));
-  ThreadArgs *args = (ThreadArgs*) malloc(num_threads * sizeof(ThreadArgs));
-
-  if (!threads || !args) {
-    fprintf(stderr, "Erro de alocação de memória para threads\n");
-    liberar_heaps(heaps, M);
-    free(heaps);
-    liberar_dataset(&dataset);
-    return 1;
-  }
-
-  // Dividir o trabalho entre as threads
-  int pontos_por_thread = N / num_threads;
-  int pontos_restantes = N % num_threads;
-
-  for (int i = 0; i < num_threads; i++) {
-    args[i].dataset = &dataset;
-    args[i].heaps = heaps;
-
-    // Calcular o início da fatia para esta thread
-    int inicio_fatia = i * pontos_por_thread;
-    args[i].ini = &dataset.treino[inicio_fatia];
-
-    // Calcular o número de pontos desta fatia
-    args[i].n = pontos_por_thread;
-    if (i == num_threads - 1) {
-      args[i].n += pontos_restantes; // A última thread pega os pontos restantes
+  if (opcoes->autojuncao) {
+    printf("Iniciando self-join com %d threads...\n", num_threads);
+    if (autojuncao_executar(&dataset, heaps, num_threads, 0) != 0) {
+      liberar_heaps(heaps, M);
+      free(heaps);
+      liberar_dataset(&dataset);
+      trace_fim("busca");
+      return 1;
     }
-
-    // Criar a thread
-    if (pthread_create(&threads[i], NULL, thread_worker, &args[i]) != 0) {
-      fprintf(stderr, "Erro ao criar thread %d\n", i);
-      // Cleanup das threads já criadas
-      for (int j = 0; j < i; j++) {
-        pthread_join(threads[j], NULL);
-      }
-      free(threads);
-      free(args);
+  } else if (opcoes->pq) {
+    // O contexto treina a PQ sobre uma amostra e codifica o treino lido do
+    // disco em lotes, sem carregá-lo inteiro; o re-ranqueamento lê do disco
+    // só as linhas candidatas
+    printf("Treinando a PQ (m=%d, %d bits)...\n", opcoes->pq, opcoes->pq_bits);
+    trace_inicio("pq");
+    ParametrosPQ params = {opcoes->pq, opcoes->pq_bits, opcoes->rerank, NULL};
+    KnnContexto *ctx = knn_create_pq_from_file(arquivo_treino, num_threads, &params);
+    int ret = ctx ? 0 : -1;
+    trace_fim("pq");
+    if (ret == 0) {
+      struct timeval fim_pq;
+      gettimeofday(&fim_pq, NULL);
+      printf("Tempo de construção da PQ: %.6f segundos\n",
+             calcular_tempo(inicio_processamento, fim_pq));
+      printf("Códigos: %.2f MiB (%d bytes por ponto)\n",
+             (double) N * opcoes->pq * opcoes->pq_bits / 8 / (1 << 20),
+             opcoes->pq * opcoes->pq_bits / 8);
+      printf("Iniciando processamento paralelo com %d threads (PQ", num_threads);
+      if (opcoes->rerank) printf(", re-ranqueamento de %d candidatos", opcoes->rerank);
+      printf(")...\n");
+      ret = knn_query_points(ctx, dataset.teste, M, K, heaps);
+    }
+    knn_destroy(ctx);
+    if (ret != 0) {
       liberar_heaps(heaps, M);
       free(heaps);
       liberar_dataset(&dataset);
+      trace_fim("busca");
       return 1;
     }
-  }
-
-  // 3. AGUARDAR CONCLUSÃO DE TODAS AS THREADS
-  for (int i = 0; i < num_threads; i++) {
-    if (pthread_join(threads[i], NULL) != 0) {
-      fprintf(stderr, "Erro ao aguardar thread %d\n", i);
+  } else {
+    KnnContexto *ctx = knn_create_from_points(dataset.treino, N, dataset.D, num_threads);
+    int ret = ctx ? knn_configure(ctx, &cfg) : -1;
+    if (ret == 0 && opcoes->indice) {
+      printf("Construindo índice por norma...\n");
+      ret = knn_build_index(ctx);
+    }
+    if (ret == 0) {
+      printf("Iniciando processamento paralelo com %d threads (", num_threads);
+      if (opcoes->indice) {
+        printf("índice por norma");
+      } else {
+        printf("motor %s", motor_nome(cfg.tipo));
+        if (cfg.tipo == MOTOR_BLOCOS) {
+          printf(", blocos %d x %d", cfg.bloco_teste, cfg.bloco_treino);
+        }
+      }
+      printf(")...\n");
+      ret = knn_query_points(ctx, dataset.teste, M, K, heaps);
+    }
+    knn_destroy(ctx);
+    if (ret != 0) {
+      liberar_heaps(heaps, M);
+      free(heaps);
+      liberar_dataset(&dataset);
+      trace_fim("busca");
+      return 1;
     }
   }
 
+  trace_fim("busca");
   gettimeofday(&fim_processamento, NULL);
 
   printf("Processamento paralelo concluído!\n");
 
   // 4. CLASSIFICAÇÃO E SAÍDA
   printf("Salvando resultados...\n");
-  char *filename = argc == 6 ? argv[5] : "output.txt";
-  salvar_resultados(heaps, M, K, filename);
+  trace_inicio("saida");
+  // Um shard só gera a saída texto se ela for pedida explicitamente
+  if (opcoes->saida || opcoes->shard_ini < 0) {
+    salvar_resultados(heaps, M, K, opcoes->saida ? opcoes->saida : "output.txt");
+  }
+  if (opcoes->parcial) {
+    int ini = opcoes->shard_ini < 0 ? 0 : opcoes->shard_ini;
+    // Um shard sem o arquivo parcial não pode ser combinado: a execução falha
+    if (parcial_escrever_heaps(opcoes->parcial, heaps, M, K, ini, ini + N) != 0) {
+      liberar_heaps(heaps, M);
+      free(heaps);
+      liberar_dataset(&dataset);
+      trace_fim("saida");
+      return 1;
+    }
+    printf("Resultados parciais (treino [%d, %d)) salvos em %s\n", ini, ini + N,
+           opcoes->parcial);
+  }
+  trace_fim("saida");
 
   // Exibir alguns resultados no terminal para verificação
   printf("\nPrimeiros resultados (verificação):\n");
@@ -492,8 +755,6 @@ int main(int argc, char *argv[]) {
                       num_threads);
 
   // 6. LIBERAÇÃO DE MEMÓRIA
-  free(threads);
-  free(args);
   liberar_heaps(heaps, M);
   free(heaps);
   liberar_dataset(&dataset);
@@ -501,3 +762,36 @@ int main(int argc, char *argv[]) {
   printf("\n=== EXECUÇÃO CONCLUÍDA COM SUCESSO ===\n");
   return 0;
 }
+
+/**
+ * @brief Função principal
+ */
+int main(int argc, char *argv[]) {
+  Opcoes opcoes;
+  if (argc < 5 || ler_opcoes(argc, argv, &opcoes) != 0) {
+    exibir_uso(argv[0]);
+    return 1;
+  }
+
+  // Parse dos argumentos
+  const char *arquivo_treino = argv[1];
+  const char *arquivo_teste = argv[2];
+  int K = atoi(argv[3]);
+  int num_threads = atoi(argv[4]);
+
+  // Validação básica dos parâmetros
+  if (K <= 0) {
+    fprintf(stderr, "Erro: K deve ser positivo\n");
+    return 1;
+  }
+  if (num_threads <= 0 && !opcoes.automatico) {
+    fprintf(stderr, "Erro: Número de threads deve ser positivo\n");
+    return 1;
+  }
+
+  if (opcoes.trace && trace_iniciar() != 0) return 1;
+  int ret = executar_knn(arquivo_treino, arquivo_teste, K, num_threads, &opcoes);
+  // Também nas execuções com erro, para mostrar onde cada thread parou
+  gravar_trace(&opcoes);
+  return ret;
+}
@@ -0,0 +1,257 @@
+/**
+ * @file merge.c
+ * @brief Combina arquivos de resultados parciais no top-K final.
+ *
+ * Cada thread fica responsável por uma faixa contígua de pontos de teste e a
+ * processa em blocos: lê o bloco correspondente de todos os arquivos
+ * parciais, combina as listas de cada consulta em uma heap de tamanho K e
+ * grava o bloco combinado na saída. Assim a memória usada depende apenas do
+ * tamanho do bloco e do número de arquivos, não do número de consultas.
+ */
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "heap.h"
+#include "parcial.h"
+#include "trace.h"
+
+#define CONSULTAS_POR_BLOCO 64
+
+/**
+ * @brief Argumentos de cada thread de combinação.
+ */
+typedef struct {
+  const ArquivoParcial *entradas; /**< Arquivos parciais de entrada. */
+  int n_entradas;                 /**< Número de arquivos de entrada. */
+  const ArquivoParcial *saida;    /**< Arquivo parcial de saída. */
+  int q_ini;                      /**< Primeira consulta da faixa. */
+  int q_fim;                      /**< Consulta seguinte à última da faixa. */
+  int erro;                       /**< Diferente de zero se a thread falhou. */
+} MergeArgs;
+
+/**
+ * @brief Combina as consultas `[q_ini, q_fim)` de todas as entradas.
+ */
+static void *merge_worker(void *args) {
+  MergeArgs *arg = (MergeArgs*) args;
+  int K = (int) arg->saida->cab.k;
+
+  Vizinho *entrada = (Vizinho*) malloc((size_t) arg->n_entradas *
+                                       CONSULTAS_POR_BLOCO * K * sizeof(Vizinho));
+  Vizinho *saida = (Vizinho*) malloc((size_t) CONSULTAS_POR_BLOCO * K * sizeof(Vizinho));
+  HeapElem *ordenados = (HeapElem*) malloc(K * sizeof(HeapElem));
+  Heap heap;
+  heap_init(&heap, K);
+
+  if (!entrada || !saida || !ordenados || !heap.data) {
+    fprintf(stderr, "Erro de alocação de memória na combinação\n");
+    arg->erro = 1;
+  }
+
+  for (int q = arg->q_ini; q < arg->q_fim && !arg->erro; q += CONSULTAS_POR_BLOCO) {
+    int n = arg->q_fim - q < CONSULTAS_POR_BLOCO ? arg->q_fim - q : CONSULTAS_POR_BLOCO;
+
+    trace_inicio_faixa("leitura", q, q + n);
+    for (int f = 0; f < arg->n_entradas; f++) {
+      if (parcial_ler(&arg->entradas[f], q, n,
+                      entrada + (size_t) f * CONSULTAS_POR_BLOCO * K) != 0) {
+        fprintf(stderr, "Erro ao ler consultas %d-%d da entrada %d\n", q, q + n - 1, f);
+        arg->erro = 1;
+        break;
+      }
+    }
+    trace_fim("leitura");
+    if (arg->erro) break;
+
+    trace_inicio_faixa("combinacao", q, q + n);
+    for (int i = 0; i < n; i++) {
+      heap.n_elem = 0;
+      for (int f = 0; f < arg->n_entradas; f++) {
+        const Vizinho *lista = entrada + ((size_t) f * CONSULTAS_POR_BLOCO + i) * K;
+        // Cada lista está ordenada: ao passar do pior da heap cheia, o resto também passa
+        for (int j = 0; j < K && lista[j].id >= 0; j++) {
+          // A heap guarda ids em int: truncar trocaria o vizinho por outro
+          if (lista[j].id > INT_MAX) {
+            fprintf(stderr, "Erro: id %lld na consulta %d da entrada %d passa de %d\n",
+                    (long long) lista[j].id, q + i, f, INT_MAX);
+            arg->erro = 1;
+            break;
+          }
+          if (heap.n_elem == K && lista[j].dist >= heap.data[0].dist) break;
+          heap_inserir(&heap, lista[j].dist, (int) lista[j].id);
+        }
+        if (arg->erro) break;
+      }
+      if (arg->erro) break;
+
+      parcial_linha_de_heap(&heap, K, ordenados, saida + (size_t) i * K);
+    }
+    trace_fim("combinacao");
+    if (arg->erro) break;
+
+    trace_inicio_faixa("saida", q, q + n);
+    if (parcial_gravar(arg->saida, q, n, saida) != 0) {
+      fprintf(stderr, "Erro ao gravar consultas %d-%d\n", q, q + n - 1);
+      arg->erro = 1;
+    }
+    trace_fim("saida");
+  }
+
+  heap_libera(&heap);
+  free(ordenados);
+  free(saida);
+  free(entrada);
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  const char *texto = NULL;
+  const char *arquivo_trace = NULL;
+  while (argc >= 3 && (strcmp(argv[argc - 2], "--texto") == 0 ||
+                       strcmp(argv[argc - 2], "--trace") == 0)) {
+    if (strcmp(argv[argc - 2], "--texto") == 0) {
+      texto = argv[argc - 1];
+    } else {
+      arquivo_trace = argv[argc - 1];
+    }
+    argc -= 2;
+  }
+
+  if (argc < 4) {
+    fprintf(stderr, "Uso: %s <N_THREADS> <saida> <parcial1> [parcial2 ...] [--texto <arquivo>] [--trace <arquivo.json>]\n", argv[0]);
+    fprintf(stderr, "  N_THREADS: número de threads a serem usadas\n");
+    fprintf(stderr, "  saida: arquivo parcial combinado a ser gerado\n");
+    fprintf(stderr, "  parcialI: arquivos gerados por knn_main --parcial\n");
+    fprintf(stderr, "  --texto: também salva o resultado no formato de output.txt\n");
+    fprintf(stderr, "  --trace: grava a linha do tempo das threads (Chrome/Perfetto)\n");
+    fprintf(stderr, "Exemplo: %s 4 final.part s0.part s1.part --texto output.txt\n", argv[0]);
+    return 1;
+  }
+
+  int num_threads = atoi(argv[1]);
+  const char *arquivo_saida = argv[2];
+  int n_entradas = argc - 3;
+
+  if (num_threads <= 0) {
+    fprintf(stderr, "Erro: Número de threads deve ser positivo\n");
+    return 1;
+  }
+
+  if (arquivo_trace && trace_iniciar() != 0) return 1;
+
+  struct timeval inicio, fim;
+  gettimeofday(&inicio, NULL);
+
+  ArquivoParcial *entradas = (ArquivoParcial*) malloc(n_entradas * sizeof(ArquivoParcial));
+  if (!entradas) {
+    fprintf(stderr, "Erro de alocação de memória para entradas\n");
+    return 1;
+  }
+
+  CabecalhoParcial cab;
+  int abertas = 0;
+  int ret = 0;
+  for (; abertas < n_entradas; abertas++) {
+    if (parcial_abrir(argv[3 + abertas], &entradas[abertas]) != 0) {
+      ret = 1;
+      break;
+    }
+    const CabecalhoParcial *c = &entradas[abertas].cab;
+    if (abertas == 0) {
+      cab = *c;
+    } else if (c->m != cab.m || c->k != cab.k) {
+      fprintf(stderr, "Erro: %s tem M=%u, K=%u; esperado M=%u, K=%u\n",
+              argv[3 + abertas], c->m, c->k, cab.m, cab.k);
+      parcial_fechar(&entradas[abertas]);
+      ret = 1;
+      break;
+    } else {
+      if (c->ini < cab.ini) cab.ini = c->ini;
+      if (c->fim > cab.fim) cab.fim = c->fim;
+    }
+  }
+
+  // Faixas de treino sobrepostas fariam o mesmo ponto aparecer duas vezes
+  for (int i = 0; i < abertas && ret == 0; i++) {
+    for (int j = i + 1; j < abertas && ret == 0; j++) {
+      if (entradas[i].cab.ini < entradas[j].cab.fim &&
+          entradas[j].cab.ini < entradas[i].cab.fim) {
+        fprintf(stderr, "Erro: %s e %s cobrem faixas de treino sobrepostas\n",
+                argv[3 + i], argv[3 + j]);
+        ret = 1;
+      }
+    }
+  }
+
+  ArquivoParcial saida;
+  if (ret == 0 && parcial_criar(arquivo_saida, &cab, &saida) != 0) ret = 1;
+
+  if (ret == 0) {
+    printf("Combinando %d arquivos parciais (M=%u, K=%u, treino [%lld, %lld)) com %d threads...\n",
+           n_entradas, cab.m, cab.k, (long long) cab.ini, (long long) cab.fim, num_threads);
+
+    pthread_t *threads = (pthread_t*) malloc(num_threads * sizeof(pthread_t));
+    MergeArgs *args = (MergeArgs*) malloc(num_threads * sizeof(MergeArgs));
+    if (!threads || !args) {
+      fprintf(stderr, "Erro de alocação de memória para threads\n");
+      ret = 1;
+    }
+
+    int criadas = 0;
+    int consultas_por_thread = (int) cab.m / num_threads;
+    int consultas_restantes = (int) cab.m % num_threads;
+    for (int i = 0; i < num_threads && ret == 0; i++) {
+      args[i].entradas = entradas;
+      args[i].n_entradas = n_entradas;
+      args[i].saida = &saida;
+      args[i].q_ini = i * consultas_por_thread;
+      args[i].q_fim = args[i].q_ini + consultas_por_thread;
+      if (i == num_threads - 1) args[i].q_fim += consultas_restantes;
+      args[i].erro = 0;
+      if (pthread_create(&threads[i], NULL, merge_worker, &args[i]) != 0) {
+        fprintf(stderr, "Erro ao criar thread %d\n", i);
+        ret = 1;
+        break;
+      }
+      criadas++;
+    }
+    for (int i = 0; i < criadas; i++) {
+      pthread_join(threads[i], NULL);
+      if (args[i].erro) ret = 1;
+    }
+
+    free(threads);
+    free(args);
+    if (parcial_fechar(&saida) != 0) ret = 1;
+  }
+
+  for (int i = 0; i < abertas; i++) parcial_fechar(&entradas[i]);
+  free(entradas);
+
+  if (ret == 0 && texto) {
+    trace_inicio("texto");
+    if (parcial_salvar_texto(arquivo_saida, texto) != 0) ret = 1;
+    trace_fim("texto");
+  }
+
+  gettimeofday(&fim, NULL);
+  if (arquivo_trace) {
+    trace_gravar(arquivo_trace);
+    trace_encerrar();
+  }
+  if (ret != 0) {
+    fprintf(stderr, "Falha ao combinar os resultados parciais\n");
+    return 1;
+  }
+
+  printf("Resultado combinado salvo em %s\n", arquivo_saida);
+  if (texto) printf("Resultados salvos em %s\n", texto);
+  printf("Tempo de combinação: %.6f segundos\n",
+         (fim.tv_sec - inicio.tv_sec) + (fim.tv_usec - inicio.tv_usec) / 1000000.0);
+  return 0;
+}
@@ -0,0 +1,139 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "motor.h"
+#include "trace.h"
+#include "utils.h"
+
+#define BLOCO_TESTE_PADRAO 32
+
+// Folga relativa no corte pela pior distância da heap, para que um empate
+// arredondado de forma diferente por sqrt() nunca seja descartado
+#define FOLGA_CORTE (1 + 1e-12)
+
+const char *motor_nome(TipoMotor tipo) {
+  switch (tipo) {
+  case MOTOR_FATIAS: return "fatias";
+  case MOTOR_BLOCOS: return "blocos";
+  }
+  return "desconhecido";
+}
+
+int motor_de_nome(const char *nome) {
+  if (strcmp(nome, "fatias") == 0) return MOTOR_FATIAS;
+  if (strcmp(nome, "blocos") == 0) return MOTOR_BLOCOS;
+  return -1;
+}
+
+void motor_blocos_padrao(ConfigMotor *cfg, int D, long cache_bytes) {
+  long bytes_ponto = (long) D * sizeof(double) + sizeof(Ponto);
+  long bloco = cache_bytes / 2 / bytes_ponto;
+  cfg->bloco_treino = bloco < 16 ? 16 : (int) bloco;
+  cfg->bloco_teste = BLOCO_TESTE_PADRAO;
+}
+
+/**
+ * @brief Execução de um motor no pool: o mesmo argumento para todas as threads.
+ */
+typedef struct {
+  Dataset *dataset;        /**< Dataset com treino e teste. */
+  Heap *heaps;             /**< Heaps de todos os pontos de teste. */
+  const ConfigMotor *cfg;  /**< Motor e parâmetros. */
+} ExecucaoMotor;
+
+/**
+ * @brief Motor fatias: cada thread compara uma fatia do treino com todo o teste
+ */
+static void tarefa_fatias(int indice, int total, void *arg) {
+  ExecucaoMotor *ex = (ExecucaoMotor*) arg;
+  int N = ex->dataset->N;
+  int pontos_por_thread = N / total;
+
+  ThreadArgs args;
+  args.dataset = ex->dataset;
+  args.heaps = ex->heaps;
+  args.ini = &ex->dataset->treino[indice * pontos_por_thread];
+  args.n = pontos_por_thread;
+  if (indice == total - 1) {
+    args.n += N % total; // A última thread pega os pontos restantes
+  }
+  int ini = indice * pontos_por_thread;
+  trace_inicio_faixa("fatia", ini, ini + args.n);
+  thread_worker(&args);
+  trace_fim("fatia");
+}
+
+static void blocos_faixa(Dataset *ds, Heap *heaps, int q_ini, int q_fim,
+                         int bloco_teste, int bloco_treino) {
+  int N = ds->N;
+  int dim = ds->D;
+
+  for (int t0 = 0; t0 < N; t0 += bloco_treino) {
+    int t1 = t0 + bloco_treino < N ? t0 + bloco_treino : N;
+    trace_inicio_faixa("bloco", t0, t1);
+    for (int q0 = q_ini; q0 < q_fim; q0 += bloco_teste) {
+      int q1 = q0 + bloco_teste < q_fim ? q0 + bloco_teste : q_fim;
+      for (int q = q0; q < q1; q++) {
+        // A heap do ponto de teste pertence só a esta thread: não há trava
+        Heap *p_heap = heaps + q;
+        Ponto *p_ponto_teste = ds->teste + q;
+        for (int i = t0; i < t1; i++) {
+          double limite = INFINITY;
+          if (p_heap->n_elem == p_heap->length) {
+            limite = p_heap->data[0].dist * p_heap->data[0].dist * FOLGA_CORTE;
+          }
+          double d2 = distancia2_limitada(ds->treino + i, p_ponto_teste, dim, limite);
+          if (d2 <= limite) {
+            heap_inserir(p_heap, sqrt(d2), ds->treino[i].id);
+          }
+        }
+      }
+    }
+    trace_fim("bloco");
+  }
+}
+
+/**
+ * @brief Motor blocos: cada thread fica com uma faixa dos pontos de teste
+ */
+static void tarefa_blocos(int indice, int total, void *arg) {
+  ExecucaoMotor *ex = (ExecucaoMotor*) arg;
+  int M = ex->dataset->M;
+  int consultas_por_thread = M / total;
+  int consultas_restantes = M % total;
+  // As primeiras threads pegam um ponto de teste a mais, até esgotar o resto
+  int q_ini = indice * consultas_por_thread +
+              (indice < consultas_restantes ? indice : consultas_restantes);
+  int q_fim = q_ini + consultas_por_thread + (indice < consultas_restantes ? 1 : 0);
+
+  int bloco_teste = ex->cfg->bloco_teste > 0 ? ex->cfg->bloco_teste : BLOCO_TESTE_PADRAO;
+  int bloco_treino = ex->cfg->bloco_treino > 0 ? ex->cfg->bloco_treino : ex->dataset->N;
+  if (bloco_treino <= 0) bloco_treino = 1;
+
+  blocos_faixa(ex->dataset, ex->heaps, q_ini, q_fim, bloco_teste, bloco_treino);
+}
+
+int motor_executar_pool(Pool *pool, Dataset *dataset, Heap *heaps,
+                        const ConfigMotor *cfg) {
+  ExecucaoMotor ex = {dataset, heaps, cfg};
+  switch (cfg->tipo) {
+  case MOTOR_FATIAS:
+    pool_executar(pool, tarefa_fatias, &ex);
+    return 0;
+  case MOTOR_BLOCOS:
+    pool_executar(pool, tarefa_blocos, &ex);
+    return 0;
+  }
+  fprintf(stderr, "Erro: motor desconhecido (%d)\n", (int) cfg->tipo);
+  return -1;
+}
+
+int motor_executar(Dataset *dataset, Heap *heaps, const ConfigMotor *cfg) {
+  Pool pool;
+  if (pool_criar(&pool, cfg->num_threads) != 0) return -1;
+  int ret = motor_executar_pool(&pool, dataset, heaps, cfg);
+  pool_destruir(&pool);
+  return ret;
+}
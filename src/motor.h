@@ -0,0 +1,87 @@
+/**
+ * @file motor.h
+ * @brief Motores de busca KNN por força bruta e sua configuração.
+ *
+ * Há dois motores, que produzem exatamente os mesmos vizinhos:
+ *
+ * - **fatias**: o treino é dividido em uma fatia por thread e cada thread
+ *   compara sua fatia com todos os pontos de teste, inserindo nas heaps
+ *   compartilhadas sob o mutex de cada heap (o algoritmo original).
+ * - **blocos**: os pontos de teste são divididos entre as threads, então cada
+ *   heap tem um único dono e dispensa travas. Cada thread percorre o treino em
+ *   blocos de `bloco_treino` pontos, dimensionados para caber na cache, e
+ *   compara cada bloco com grupos de `bloco_teste` pontos de teste. Quando a
+ *   heap já está cheia, o cálculo da distância é abandonado assim que passa
+ *   do pior vizinho atual.
+ */
+
+#ifndef MOTOR_H
+#define MOTOR_H
+
+#include "heap.h"
+#include "knn.h"
+#include "pool.h"
+
+/**
+ * @brief Motores de busca disponíveis.
+ */
+typedef enum {
+  MOTOR_FATIAS = 0, /**< Fatias de treino por thread, heaps com mutex. */
+  MOTOR_BLOCOS = 1  /**< Pontos de teste por thread, em blocos de cache. */
+} TipoMotor;
+
+/**
+ * @brief Configuração completa de uma execução da busca.
+ */
+typedef struct {
+  TipoMotor tipo;   /**< Motor a ser usado. */
+  int num_threads;  /**< Número de threads. */
+  int bloco_teste;  /**< Pontos de teste por grupo (só no motor blocos). */
+  int bloco_treino; /**< Pontos de treino por bloco (só no motor blocos). */
+} ConfigMotor;
+
+/**
+ * @brief Nome textual de um motor (`"fatias"` ou `"blocos"`).
+ */
+const char *motor_nome(TipoMotor tipo);
+
+/**
+ * @brief Converte um nome textual em ::TipoMotor.
+ *
+ * @return o motor correspondente, ou -1 se o nome for desconhecido.
+ */
+int motor_de_nome(const char *nome);
+
+/**
+ * @brief Preenche tamanhos de bloco padrão para o motor blocos.
+ *
+ * @details O bloco de treino é escolhido para ocupar cerca de metade da
+ * cache `cache_bytes`; o bloco de teste fica fixo em 32 pontos.
+ *
+ * @param cfg Configuração a ser ajustada.
+ * @param D Número de dimensões.
+ * @param cache_bytes Tamanho da cache usada como referência (ex.: L2).
+ */
+void motor_blocos_padrao(ConfigMotor *cfg, int D, long cache_bytes);
+
+/**
+ * @brief Executa a busca dos K vizinhos de todos os pontos de teste.
+ *
+ * @param dataset Dataset com treino e teste carregados.
+ * @param heaps Vetor de `dataset->M` heaps inicializadas com capacidade K.
+ * @param cfg Motor e parâmetros a serem usados.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int motor_executar(Dataset *dataset, Heap *heaps, const ConfigMotor *cfg);
+
+/**
+ * @brief Executa a busca usando as threads de um pool já criado.
+ *
+ * @details O número de threads é o do pool; `cfg->num_threads` é ignorado.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int motor_executar_pool(Pool *pool, Dataset *dataset, Heap *heaps,
+                        const ConfigMotor *cfg);
+
+#endif // !MOTOR_H
@@ -0,0 +1,165 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "parcial.h"
+
+// Offset do primeiro vizinho da consulta `q`
+static off_t offset_consulta(const CabecalhoParcial *c, int q) {
+  return (off_t) sizeof(CabecalhoParcial) + (off_t) q * c->k * sizeof(Vizinho);
+}
+
+// pread/pwrite podem transferir menos bytes do que o pedido; repete até o fim
+static int transferir(int fd, void *buf, size_t bytes, off_t offset, int escrita) {
+  char *p = (char*) buf;
+  while (bytes > 0) {
+    ssize_t r = escrita ? pwrite(fd, p, bytes, offset) : pread(fd, p, bytes, offset);
+    if (r < 0 && errno == EINTR) continue;
+    if (r <= 0) return -1;
+    p += r;
+    bytes -= r;
+    offset += r;
+  }
+  return 0;
+}
+
+int parcial_abrir(const char *filename, ArquivoParcial *arq) {
+  arq->fd = open(filename, O_RDONLY);
+  if (arq->fd < 0) {
+    fprintf(stderr, "Erro ao abrir arquivo parcial: %s\n", filename);
+    return -1;
+  }
+  if (transferir(arq->fd, &arq->cab, sizeof(arq->cab), 0, 0) != 0 ||
+      memcmp(arq->cab.magico, PARCIAL_MAGICO, 4) != 0) {
+    fprintf(stderr, "Erro: %s não é um arquivo de resultados parciais\n", filename);
+    close(arq->fd);
+    return -1;
+  }
+  if (arq->cab.versao != PARCIAL_VERSAO || arq->cab.k == 0) {
+    fprintf(stderr, "Erro: cabeçalho inválido em %s\n", filename);
+    close(arq->fd);
+    return -1;
+  }
+  off_t tamanho = lseek(arq->fd, 0, SEEK_END);
+  if (tamanho != offset_consulta(&arq->cab, arq->cab.m)) {
+    fprintf(stderr, "Erro: %s está truncado\n", filename);
+    close(arq->fd);
+    return -1;
+  }
+  return 0;
+}
+
+int parcial_criar(const char *filename, const CabecalhoParcial *cab,
+                  ArquivoParcial *arq) {
+  arq->cab = *cab;
+  memcpy(arq->cab.magico, PARCIAL_MAGICO, 4);
+  arq->cab.versao = PARCIAL_VERSAO;
+  arq->cab.reservado = 0;
+
+  arq->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (arq->fd < 0) {
+    fprintf(stderr, "Erro ao criar arquivo parcial: %s\n", filename);
+    return -1;
+  }
+  if (transferir(arq->fd, &arq->cab, sizeof(arq->cab), 0, 1) != 0 ||
+      ftruncate(arq->fd, offset_consulta(&arq->cab, arq->cab.m)) != 0) {
+    fprintf(stderr, "Erro ao gravar o cabeçalho de %s\n", filename);
+    close(arq->fd);
+    return -1;
+  }
+  return 0;
+}
+
+int parcial_ler(const ArquivoParcial *arq, int q, int n, Vizinho *buf) {
+  return transferir(arq->fd, buf, (size_t) n * arq->cab.k * sizeof(Vizinho),
+                    offset_consulta(&arq->cab, q), 0);
+}
+
+int parcial_gravar(const ArquivoParcial *arq, int q, int n, const Vizinho *buf) {
+  return transferir(arq->fd, (void*) buf, (size_t) n * arq->cab.k * sizeof(Vizinho),
+                    offset_consulta(&arq->cab, q), 1);
+}
+
+int parcial_fechar(ArquivoParcial *arq) {
+  int ret = close(arq->fd);
+  arq->fd = -1;
+  return ret;
+}
+
+void parcial_linha_de_heap(const Heap *h, int K, HeapElem *tmp, Vizinho *linha) {
+  heap_extrair_ordenado(h, tmp);
+  for (int j = 0; j < K; j++) {
+    if (j < h->n_elem) {
+      linha[j] = (Vizinho){tmp[j].dist, tmp[j].id};
+    } else {
+      linha[j] = (Vizinho){INFINITY, -1};
+    }
+  }
+}
+
+int parcial_escrever_heaps(const char *filename, Heap *heaps, int M, int K,
+                           int64_t ini, int64_t fim) {
+  CabecalhoParcial cab = {.m = M, .k = K, .ini = ini, .fim = fim};
+  ArquivoParcial arq;
+  if (parcial_criar(filename, &cab, &arq) != 0) return -1;
+
+  HeapElem *ordenados = (HeapElem*) malloc(K * sizeof(HeapElem));
+  Vizinho *linha = (Vizinho*) malloc(K * sizeof(Vizinho));
+  int ret = ordenados && linha ? 0 : -1;
+
+  for (int i = 0; i < M && ret == 0; i++) {
+    parcial_linha_de_heap(&heaps[i], K, ordenados, linha);
+    ret = parcial_gravar(&arq, i, 1, linha);
+  }
+
+  free(ordenados);
+  free(linha);
+  if (parcial_fechar(&arq) != 0) ret = -1;
+  if (ret != 0) {
+    fprintf(stderr, "Erro ao gravar resultados parciais em %s\n", filename);
+  }
+  return ret;
+}
+
+int parcial_salvar_texto(const char *parcial, const char *texto) {
+  ArquivoParcial arq;
+  if (parcial_abrir(parcial, &arq) != 0) return -1;
+
+  FILE *file = fopen(texto, "w");
+  Vizinho *linha = (Vizinho*) malloc(arq.cab.k * sizeof(Vizinho));
+  if (!file || !linha) {
+    fprintf(stderr, "Erro ao criar arquivo de saída %s\n", texto);
+    if (file) fclose(file);
+    free(linha);
+    parcial_fechar(&arq);
+    return -1;
+  }
+
+  int ret = 0;
+  fprintf(file, "Resultados do KNN (K=%u)\n", arq.cab.k);
+  fprintf(file, "==============================\n\n");
+
+  for (uint32_t i = 0; i < arq.cab.m && ret == 0; i++) {
+    ret = parcial_ler(&arq, i, 1, linha);
+    fprintf(file, "Ponto de teste %u:\n", i);
+    fprintf(file, "K-vizinhos mais próximos:\n");
+    for (uint32_t j = 0; j < arq.cab.k && ret == 0; j++) {
+      if (linha[j].id < 0) break;
+      fprintf(file, "  ID: %lld, Distância: %.6f\n", (long long) linha[j].id,
+              linha[j].dist);
+    }
+    fprintf(file, "\n");
+  }
+
+  free(linha);
+  if (fclose(file) != 0) ret = -1;
+  parcial_fechar(&arq);
+  if (ret != 0) fprintf(stderr, "Erro ao converter %s para texto\n", parcial);
+  return ret;
+}
@@ -0,0 +1,138 @@
+/**
+ * @file parcial.h
+ * @brief Formato binário de resultados parciais (top-K por consulta).
+ *
+ * Um arquivo parcial guarda, para cada ponto de teste, os K vizinhos mais
+ * próximos encontrados em um subconjunto `[ini, fim)` do treino, com ids
+ * globais. Após o cabeçalho de 32 bytes vêm `M * K` registros ::Vizinho,
+ * ordenados por distância crescente dentro de cada consulta. Consultas com
+ * menos de K candidatos são completadas com `id = -1` e distância infinita.
+ *
+ * Como cada consulta ocupa um trecho de tamanho fixo, arquivos parciais podem
+ * ser lidos e escritos por várias threads ao mesmo tempo (`pread`/`pwrite`),
+ * e a combinação de parciais produz um novo arquivo no mesmo formato.
+ */
+
+#ifndef PARCIAL_H
+#define PARCIAL_H
+
+#include <stdint.h>
+
+#include "heap.h"
+
+#define PARCIAL_MAGICO "KNNP" /**< Número mágico dos arquivos parciais. */
+#define PARCIAL_VERSAO 1      /**< Versão atual do formato parcial. */
+
+/**
+ * @brief Cabeçalho de 32 bytes de um arquivo parcial.
+ */
+typedef struct {
+  char magico[4];   /**< `"KNNP"`. */
+  uint16_t versao;  /**< Versão do formato. */
+  uint16_t reservado; /**< Sempre zero. */
+  uint32_t m;       /**< Número de pontos de teste. */
+  uint32_t k;       /**< Número de vizinhos por ponto de teste. */
+  int64_t ini;      /**< Primeira linha de treino coberta. */
+  int64_t fim;      /**< Linha seguinte à última linha de treino coberta. */
+} CabecalhoParcial;
+
+/**
+ * @brief Um vizinho gravado no arquivo parcial.
+ */
+typedef struct {
+  double dist; /**< Distância até o ponto de teste. */
+  int64_t id;  /**< Id global do ponto de treino (-1 para preenchimento). */
+} Vizinho;
+
+/**
+ * @brief Arquivo parcial aberto por parcial_abrir() ou parcial_criar().
+ */
+typedef struct {
+  int fd;               /**< Descritor do arquivo. */
+  CabecalhoParcial cab; /**< Cabeçalho do arquivo. */
+} ArquivoParcial;
+
+/**
+ * @brief Converte uma heap em uma linha de K vizinhos ordenados.
+ *
+ * @details Posições sem candidato recebem `id = -1` e distância infinita.
+ *
+ * @param h Heap com os resultados de um ponto de teste.
+ * @param K Número de vizinhos da linha.
+ * @param tmp Vetor auxiliar com espaço para K elementos.
+ * @param linha Vetor de saída com espaço para K vizinhos.
+ */
+void parcial_linha_de_heap(const Heap *h, int K, HeapElem *tmp, Vizinho *linha);
+
+/**
+ * @brief Grava as heaps de todos os pontos de teste em um arquivo parcial.
+ *
+ * @param filename Caminho do arquivo de saída.
+ * @param heaps Vetor de `M` heaps com os resultados.
+ * @param M Número de pontos de teste.
+ * @param K Número de vizinhos por ponto de teste.
+ * @param ini Primeira linha de treino coberta pelas heaps.
+ * @param fim Linha seguinte à última linha de treino coberta.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int parcial_escrever_heaps(const char *filename, Heap *heaps, int M, int K,
+                           int64_t ini, int64_t fim);
+
+/**
+ * @brief Abre um arquivo parcial para leitura e valida seu cabeçalho.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int parcial_abrir(const char *filename, ArquivoParcial *arq);
+
+/**
+ * @brief Cria um arquivo parcial vazio com o cabeçalho informado.
+ *
+ * @details O arquivo é estendido até o tamanho final, de modo que as
+ * consultas possam ser gravadas em qualquer ordem por parcial_gravar().
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int parcial_criar(const char *filename, const CabecalhoParcial *cab,
+                  ArquivoParcial *arq);
+
+/**
+ * @brief Lê os vizinhos das consultas `[q, q + n)`.
+ *
+ * @details Seguro para uso concorrente no mesmo arquivo.
+ *
+ * @param arq Arquivo parcial aberto.
+ * @param q Primeira consulta.
+ * @param n Número de consultas.
+ * @param buf Vetor com espaço para `n * K` vizinhos.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int parcial_ler(const ArquivoParcial *arq, int q, int n, Vizinho *buf);
+
+/**
+ * @brief Grava os vizinhos das consultas `[q, q + n)`.
+ *
+ * @details Seguro para uso concorrente no mesmo arquivo, desde que as
+ * faixas de consultas não se sobreponham.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int parcial_gravar(const ArquivoParcial *arq, int q, int n, const Vizinho *buf);
+
+/**
+ * @brief Fecha um arquivo parcial.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int parcial_fechar(ArquivoParcial *arq);
+
+/**
+ * @brief Converte um arquivo parcial para o formato texto de `output.txt`.
+ *
+ * @param parcial Caminho do arquivo parcial.
+ * @param texto Caminho do arquivo texto a ser gerado.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int parcial_salvar_texto(const char *parcial, const char *texto);
+
+#endif // !PARCIAL_H
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pool.h"
+
+static void *pool_worker(void *args) {
+  ThreadPool *t = (ThreadPool*) args;
+  Pool *pool = t->pool;
+  unsigned long vista = 0;
+
+  pthread_mutex_lock(&pool->mutex);
+  for (;;) {
+    while (pool->geracao == vista && !pool->encerrar) {
+      pthread_cond_wait(&pool->cond_tarefa, &pool->mutex);
+    }
+    if (pool->encerrar) break;
+    vista = pool->geracao;
+    TarefaPool tarefa = pool->tarefa;
+    void *arg = pool->arg;
+    pthread_mutex_unlock(&pool->mutex);
+
+    tarefa(t->indice, pool->n, arg);
+
+    pthread_mutex_lock(&pool->mutex);
+    if (--pool->pendentes == 0) pthread_cond_signal(&pool->cond_fim);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+  return NULL;
+}
+
+int pool_criar(Pool *pool, int n) {
+  if (n <= 0) {
+    fprintf(stderr, "Erro: Número de threads deve ser positivo\n");
+    return -1;
+  }
+  // Em qualquer falha o pool fica zerado e pool_destruir() não faz nada
+  pool->threads = NULL;
+  pool->args = NULL;
+  pool->n = 0;
+  pthread_t *threads = (pthread_t*) malloc(n * sizeof(pthread_t));
+  ThreadPool *args = (ThreadPool*) malloc(n * sizeof(ThreadPool));
+  if (!threads || !args) {
+    fprintf(stderr, "Erro de alocação de memória para threads\n");
+    free(threads);
+    free(args);
+    return -1;
+  }
+  pool->threads = threads;
+  pool->args = args;
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->cond_tarefa, NULL);
+  pthread_cond_init(&pool->cond_fim, NULL);
+  pool->tarefa = NULL;
+  pool->arg = NULL;
+  pool->geracao = 0;
+  pool->pendentes = 0;
+  pool->encerrar = 0;
+
+  for (pool->n = 0; pool->n < n; pool->n++) {
+    pool->args[pool->n] = (ThreadPool){pool, pool->n};
+    if (pthread_create(&pool->threads[pool->n], NULL, pool_worker,
+                       &pool->args[pool->n]) != 0) {
+      fprintf(stderr, "Erro ao criar thread %d\n", pool->n);
+      pool_destruir(pool);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void pool_executar(Pool *pool, TarefaPool tarefa, void *arg) {
+  pthread_mutex_lock(&pool->mutex);
+  pool->tarefa = tarefa;
+  pool->arg = arg;
+  pool->pendentes = pool->n;
+  pool->geracao++;
+  pthread_cond_broadcast(&pool->cond_tarefa);
+  while (pool->pendentes > 0) {
+    pthread_cond_wait(&pool->cond_fim, &pool->mutex);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+void pool_destruir(Pool *pool) {
+  if (!pool->threads) return;
+  pthread_mutex_lock(&pool->mutex);
+  pool->encerrar = 1;
+  pthread_cond_broadcast(&pool->cond_tarefa);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (int i = 0; i < pool->n; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+  pthread_mutex_destroy(&pool->mutex);
+  pthread_cond_destroy(&pool->cond_tarefa);
+  pthread_cond_destroy(&pool->cond_fim);
+  free(pool->threads);
+  free(pool->args);
+  pool->threads = NULL;
+  pool->args = NULL;
+  pool->n = 0;
+}
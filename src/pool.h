@@ -0,0 +1,78 @@
+/**
+ * @file pool.h
+ * @brief Conjunto persistente de threads de trabalho.
+ *
+ * As threads são criadas uma vez e ficam bloqueadas em uma variável de
+ * condição entre as execuções. Cada chamada a pool_executar() entrega a mesma
+ * tarefa a todas as threads, com o índice de cada uma, e espera todas
+ * terminarem; assim o custo por chamada é só o de acordar e sincronizar as
+ * threads, sem `pthread_create`/`pthread_join`.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+
+/**
+ * @brief Tarefa executada por cada thread do pool.
+ *
+ * @param indice Índice da thread, de 0 a `total - 1`.
+ * @param total Número de threads do pool.
+ * @param arg Argumento passado a pool_executar().
+ */
+typedef void (*TarefaPool)(int indice, int total, void *arg);
+
+struct Pool;
+
+/**
+ * @brief Argumentos de cada thread do pool.
+ */
+typedef struct {
+  struct Pool *pool; /**< Pool ao qual a thread pertence. */
+  int indice;        /**< Índice da thread. */
+} ThreadPool;
+
+/**
+ * @brief Pool de threads.
+ */
+typedef struct Pool {
+  pthread_t *threads;       /**< Threads de trabalho. */
+  ThreadPool *args;         /**< Argumentos de cada thread. */
+  int n;                    /**< Número de threads. */
+  pthread_mutex_t mutex;    /**< Protege os campos abaixo. */
+  pthread_cond_t cond_tarefa; /**< Sinaliza uma nova tarefa ou o encerramento. */
+  pthread_cond_t cond_fim;  /**< Sinaliza que todas as threads terminaram. */
+  TarefaPool tarefa;        /**< Tarefa da execução atual. */
+  void *arg;                /**< Argumento da tarefa atual. */
+  unsigned long geracao;    /**< Incrementado a cada execução. */
+  int pendentes;            /**< Threads que ainda não terminaram a tarefa. */
+  int encerrar;             /**< 1 quando o pool está sendo destruído. */
+} Pool;
+
+/**
+ * @brief Cria um pool com `n` threads.
+ *
+ * @details Em caso de erro o pool fica zerado: pool_destruir() pode ser
+ * chamada sobre ele e não faz nada.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int pool_criar(Pool *pool, int n);
+
+/**
+ * @brief Executa `tarefa` em todas as threads e espera o término.
+ *
+ * @details Não pode ser chamada por várias threads ao mesmo tempo no mesmo
+ * pool; quem compartilha um pool deve serializar as chamadas.
+ */
+void pool_executar(Pool *pool, TarefaPool tarefa, void *arg);
+
+/**
+ * @brief Encerra as threads e libera o pool.
+ *
+ * @details Não faz nada se o pool já foi destruído ou se a criação falhou.
+ */
+void pool_destruir(Pool *pool);
+
+#endif // !POOL_H
@@ -0,0 +1,483 @@
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#include "formato.h"
+#include "pq.h"
+#include "trace.h"
+
+// Pontos da amostra de treino por centróide e iterações do k-means
+#define PQ_AMOSTRA_POR_CENTROIDE 32
+#define PQ_ITERACOES 15
+// Linhas lidas do disco e codificadas por vez (múltiplo de PQ_PONTOS_POR_BLOCO)
+#define PQ_LINHAS_POR_LOTE 4096
+
+/**
+ * @brief Argumentos das tarefas de treino e codificação.
+ */
+typedef struct {
+  IndicePQ *indice;
+  const Ponto *amostra;  /* pontos de onde sai a amostra do k-means */
+  int n_amostra;
+  const Ponto *treino;   /* pontos das linhas [ini, fim) sendo codificadas */
+  int ini, fim;
+  int proximo;           /* próximo subespaço livre no treino */
+  pthread_mutex_t mutex; /* protege `proximo` e `erro` */
+  int erro;              /* diferente de zero se alguma thread falhou */
+} ConstrucaoPQ;
+
+static void marcar_erro(ConstrucaoPQ *c) {
+  pthread_mutex_lock(&c->mutex);
+  c->erro = 1;
+  pthread_mutex_unlock(&c->mutex);
+}
+
+// Centróide mais próximo de um subvetor; devolve a distância ao quadrado em `dist`
+static int mais_proximo(const float *centroides, int ksub, int dsub, const float *x,
+                        float *dist) {
+  int melhor = 0;
+  float menor = FLT_MAX;
+  for (int c = 0; c < ksub; c++) {
+    const float *y = centroides + (size_t) c * dsub;
+    float soma = 0;
+    for (int d = 0; d < dsub; d++) {
+      float dif = x[d] - y[d];
+      soma += dif * dif;
+    }
+    if (soma < menor) {
+      menor = soma;
+      melhor = c;
+    }
+  }
+  if (dist) *dist = menor;
+  return melhor;
+}
+
+// k-means de um subespaço sobre a amostra `x` (S subvetores)
+static int kmeans(float *centroides, int ksub, int dsub, const float *x, int S) {
+  int *atrib = (int*) malloc(S * sizeof(int));
+  float *dists = (float*) malloc(S * sizeof(float));
+  double *somas = (double*) malloc((size_t) ksub * dsub * sizeof(double));
+  int *contagens = (int*) malloc(ksub * sizeof(int));
+  if (!atrib || !dists || !somas || !contagens) {
+    free(atrib);
+    free(dists);
+    free(somas);
+    free(contagens);
+    return -1;
+  }
+
+  // Centróides iniciais: pontos igualmente espaçados da amostra
+  for (int c = 0; c < ksub; c++) {
+    memcpy(centroides + (size_t) c * dsub, x + (size_t) c * S / ksub * dsub,
+           dsub * sizeof(float));
+  }
+  for (int i = 0; i < S; i++) atrib[i] = -1;
+
+  for (int it = 0; it < PQ_ITERACOES; it++) {
+    int mudancas = 0;
+    for (int i = 0; i < S; i++) {
+      int c = mais_proximo(centroides, ksub, dsub, x + (size_t) i * dsub, &dists[i]);
+      if (c != atrib[i]) mudancas++;
+      atrib[i] = c;
+    }
+    if (mudancas == 0) break;
+
+    memset(somas, 0, (size_t) ksub * dsub * sizeof(double));
+    memset(contagens, 0, ksub * sizeof(int));
+    for (int i = 0; i < S; i++) {
+      double *s = somas + (size_t) atrib[i] * dsub;
+      for (int d = 0; d < dsub; d++) s[d] += x[(size_t) i * dsub + d];
+      contagens[atrib[i]]++;
+    }
+    for (int c = 0; c < ksub; c++) {
+      float *y = centroides + (size_t) c * dsub;
+      if (contagens[c] > 0) {
+        for (int d = 0; d < dsub; d++) y[d] = (float) (somas[(size_t) c * dsub + d] / contagens[c]);
+        continue;
+      }
+      // Centróide vazio: recomeça no ponto da amostra mais mal representado
+      int pior = 0;
+      for (int i = 1; i < S; i++) {
+        if (dists[i] > dists[pior]) pior = i;
+      }
+      memcpy(y, x + (size_t) pior * dsub, dsub * sizeof(float));
+      dists[pior] = 0;
+    }
+  }
+
+  free(atrib);
+  free(dists);
+  free(somas);
+  free(contagens);
+  return 0;
+}
+
+static void tarefa_treinar(int indice, int total, void *arg) {
+  (void) indice;
+  (void) total;
+  ConstrucaoPQ *c = (ConstrucaoPQ*) arg;
+  CodificadorPQ *cod = &c->indice->cod;
+  int N = c->n_amostra;
+  int S = cod->ksub * PQ_AMOSTRA_POR_CENTROIDE;
+  if (S > N) S = N;
+
+  float *x = (float*) malloc((size_t) S * cod->dsub * sizeof(float));
+  if (!x) {
+    marcar_erro(c);
+    return;
+  }
+
+  for (;;) {
+    pthread_mutex_lock(&c->mutex);
+    int j = c->proximo++;
+    pthread_mutex_unlock(&c->mutex);
+    if (j >= cod->m) break;
+
+    // Amostra de pontos igualmente espaçados, restrita ao subespaço j
+    for (int s = 0; s < S; s++) {
+      const double *f = c->amostra[(long) s * N / S].features + (size_t) j * cod->dsub;
+      for (int d = 0; d < cod->dsub; d++) x[(size_t) s * cod->dsub + d] = (float) f[d];
+    }
+    float *centroides = cod->centroides + (size_t) j * cod->ksub * cod->dsub;
+    trace_inicio_faixa("kmeans", j, j + 1);
+    if (kmeans(centroides, cod->ksub, cod->dsub, x, S) != 0) marcar_erro(c);
+    trace_fim("kmeans");
+  }
+  free(x);
+}
+
+static void tarefa_codificar(int indice, int total, void *arg) {
+  ConstrucaoPQ *c = (ConstrucaoPQ*) arg;
+  IndicePQ *ind = c->indice;
+  const CodificadorPQ *cod = &ind->cod;
+  // Faixas alinhadas a blocos, para que cada bloco de 4 bits tenha um só dono
+  // (`c->ini` é sempre múltiplo de PQ_PONTOS_POR_BLOCO)
+  int blocos = (c->fim - c->ini + PQ_PONTOS_POR_BLOCO - 1) / PQ_PONTOS_POR_BLOCO;
+  int ini = c->ini + (int) ((long) blocos * indice / total) * PQ_PONTOS_POR_BLOCO;
+  int fim = c->ini + (int) ((long) blocos * (indice + 1) / total) * PQ_PONTOS_POR_BLOCO;
+  if (fim > c->fim) fim = c->fim;
+
+  float *x = (float*) malloc(cod->dsub * sizeof(float));
+  if (!x) {
+    marcar_erro(c);
+    return;
+  }
+  trace_inicio_faixa("codificacao", ini, fim);
+  for (int i = ini; i < fim; i++) {
+    const Ponto *p = &c->treino[i - c->ini];
+    ind->ids[i] = p->id;
+    for (int j = 0; j < cod->m; j++) {
+      const double *f = p->features + (size_t) j * cod->dsub;
+      for (int d = 0; d < cod->dsub; d++) x[d] = (float) f[d];
+      const float *centroides = cod->centroides + (size_t) j * cod->ksub * cod->dsub;
+      uint8_t codigo = (uint8_t) mais_proximo(centroides, cod->ksub, cod->dsub, x, NULL);
+
+      if (cod->bits == 8) {
+        ind->codigos[(size_t) i * cod->m + j] = codigo;
+      } else {
+        size_t bloco = (size_t) i / PQ_PONTOS_POR_BLOCO;
+        size_t pos = bloco * (cod->m / 2) * PQ_PONTOS_POR_BLOCO +
+                     (size_t) (j / 2) * PQ_PONTOS_POR_BLOCO + i % PQ_PONTOS_POR_BLOCO;
+        ind->codigos[pos] |= (uint8_t) (codigo << (4 * (j % 2)));
+      }
+    }
+  }
+  trace_fim("codificacao");
+  free(x);
+}
+
+// Valida os parâmetros e aloca dicionários, códigos e ids
+static int preparar(IndicePQ *indice, int N, int D, int m, int bits) {
+  CodificadorPQ *cod = &indice->cod;
+  memset(indice, 0, sizeof(*indice));
+
+  if (bits != 4 && bits != 8) {
+    fprintf(stderr, "Erro: a PQ aceita códigos de 4 ou 8 bits (recebido %d)\n", bits);
+    return -1;
+  }
+  if (m <= 0 || D % m != 0) {
+    fprintf(stderr, "Erro: D=%d deve ser múltiplo do número de subespaços m=%d\n", D, m);
+    return -1;
+  }
+  // Com 4 bits os pares de subespaços dividem um byte e as somas usam 16 bits
+  if (bits == 4 && (m % 2 != 0 || m > 256)) {
+    fprintf(stderr, "Erro: com 4 bits, m deve ser par e no máximo 256 (recebido %d)\n", m);
+    return -1;
+  }
+  if (N < (1 << bits)) {
+    fprintf(stderr, "Erro: a PQ de %d bits precisa de pelo menos %d pontos de treino\n",
+            bits, 1 << bits);
+    return -1;
+  }
+
+  cod->D = D;
+  cod->m = m;
+  cod->dsub = D / m;
+  cod->bits = bits;
+  cod->ksub = 1 << bits;
+  indice->N = N;
+
+  cod->centroides = (float*) malloc((size_t) m * cod->ksub * cod->dsub * sizeof(float));
+  indice->codigos = (uint8_t*) calloc(pq_bytes_codigos(indice), 1);
+  indice->ids = (int*) malloc(N * sizeof(int));
+  if (!cod->centroides || !indice->codigos || !indice->ids) {
+    fprintf(stderr, "Erro de alocação de memória para a PQ\n");
+    pq_libera(indice);
+    return -1;
+  }
+  return 0;
+}
+
+// Treina os dicionários sobre `amostra` (já com `c->mutex` iniciado)
+static int treinar(ConstrucaoPQ *c, const Ponto *amostra, int n_amostra, Pool *pool) {
+  c->amostra = amostra;
+  c->n_amostra = n_amostra;
+  pool_executar(pool, tarefa_treinar, c);
+  return c->erro ? -1 : 0;
+}
+
+// Codifica as linhas [ini, fim) do treino, dadas por `treino`
+static int codificar(ConstrucaoPQ *c, const Ponto *treino, int ini, int fim, Pool *pool) {
+  c->treino = treino;
+  c->ini = ini;
+  c->fim = fim;
+  pool_executar(pool, tarefa_codificar, c);
+  return c->erro ? -1 : 0;
+}
+
+int pq_construir(IndicePQ *indice, const Ponto *treino, int N, int D, int m, int bits,
+                 Pool *pool) {
+  if (preparar(indice, N, D, m, bits) != 0) return -1;
+
+  ConstrucaoPQ c = {.indice = indice};
+  pthread_mutex_init(&c.mutex, NULL);
+  int ret = treinar(&c, treino, N, pool);
+  if (ret == 0) ret = codificar(&c, treino, 0, N, pool);
+  pthread_mutex_destroy(&c.mutex);
+
+  if (ret != 0) {
+    fprintf(stderr, "Erro de alocação de memória no treino da PQ\n");
+    pq_libera(indice);
+    return -1;
+  }
+  return 0;
+}
+
+// Lê as linhas da amostra do k-means, igualmente espaçadas no arquivo
+static int ler_amostra(ArquivoDataset *arq, int S, Ponto **amostra) {
+  int N = (int) arq->cab.n;
+  int D = (int) arq->cab.d;
+  Ponto *p = (Ponto*) malloc(S * sizeof(Ponto));
+  double *bloco = (double*) malloc((size_t) S * D * sizeof(double));
+  unsigned char *bruto = (unsigned char*) malloc(arq->cab.passo);
+  if (!p || !bloco || !bruto) {
+    fprintf(stderr, "Erro de alocação de memória para a amostra da PQ\n");
+    free(p);
+    free(bloco);
+    free(bruto);
+    return -1;
+  }
+
+  int ret = 0;
+  for (int s = 0; s < S && ret == 0; s++) {
+    p[s].features = bloco + (size_t) s * D;
+    p[s].id = -1;
+    p[s].rotulo = -1;
+    if (formato_ler_linha(arq, (uint64_t) ((long) s * N / S), bruto, p[s].features) != 0) {
+      fprintf(stderr, "Erro ao ler a amostra de treino da PQ\n");
+      ret = -1;
+    }
+  }
+  free(bruto);
+  if (ret != 0) {
+    formato_liberar_pontos(p, S);
+    return -1;
+  }
+  *amostra = p;
+  return 0;
+}
+
+int pq_construir_arquivo(IndicePQ *indice, ArquivoDataset *arq, int m, int bits, Pool *pool) {
+  int N = (int) arq->cab.n;
+  if (preparar(indice, N, (int) arq->cab.d, m, bits) != 0) return -1;
+
+  // A mesma amostra que pq_construir() usaria com o treino inteiro em memória
+  int S = indice->cod.ksub * PQ_AMOSTRA_POR_CENTROIDE;
+  if (S > N) S = N;
+  Ponto *amostra;
+  trace_inicio("amostra");
+  int ret = ler_amostra(arq, S, &amostra);
+  trace_fim("amostra");
+  if (ret != 0) {
+    pq_libera(indice);
+    return -1;
+  }
+
+  ConstrucaoPQ c = {.indice = indice};
+  pthread_mutex_init(&c.mutex, NULL);
+  ret = treinar(&c, amostra, S, pool);
+  formato_liberar_pontos(amostra, S);
+
+  // Codificação em lotes: só um lote de vetores densos em memória por vez
+  for (int ini = 0; ini < N && ret == 0; ini += PQ_LINHAS_POR_LOTE) {
+    int fim = ini + PQ_LINHAS_POR_LOTE < N ? ini + PQ_LINHAS_POR_LOTE : N;
+    Ponto *lote;
+    trace_inicio_faixa("leitura", ini, fim);
+    ret = formato_ler_pontos(arq, ini, fim, &lote);
+    trace_fim("leitura");
+    if (ret != 0) break;
+    ret = codificar(&c, lote, ini, fim, pool);
+    formato_liberar_pontos(lote, fim - ini);
+  }
+  pthread_mutex_destroy(&c.mutex);
+
+  if (ret != 0) {
+    fprintf(stderr, "Erro na construção da PQ a partir do disco\n");
+    pq_libera(indice);
+    return -1;
+  }
+  return 0;
+}
+
+int pq_tamanho_tabela(const CodificadorPQ *cod) {
+  return cod->m * cod->ksub;
+}
+
+void pq_tabela(const CodificadorPQ *cod, const double *q, float *tabela) {
+  for (int j = 0; j < cod->m; j++) {
+    const double *x = q + (size_t) j * cod->dsub;
+    const float *centroides = cod->centroides + (size_t) j * cod->ksub * cod->dsub;
+    for (int c = 0; c < cod->ksub; c++) {
+      const float *y = centroides + (size_t) c * cod->dsub;
+      float soma = 0;
+      for (int d = 0; d < cod->dsub; d++) {
+        float dif = (float) x[d] - y[d];
+        soma += dif * dif;
+      }
+      tabela[j * cod->ksub + c] = soma;
+    }
+  }
+}
+
+// Insere um candidato se ele for melhor que o pior da heap; devolve o novo limite
+static float inserir(Heap *h, float d2, int i, float limite) {
+  if (d2 >= limite) return limite;
+  heap_inserir(h, sqrt(d2 > 0 ? d2 : 0), i);
+  if (h->n_elem < h->length) return FLT_MAX;
+  return (float) (h->data[0].dist * h->data[0].dist);
+}
+
+static void varrer_8bits(const IndicePQ *ind, const float *tabela, Heap *h) {
+  int m = ind->cod.m;
+  float limite = FLT_MAX;
+  for (int i = 0; i < ind->N; i++) {
+    const uint8_t *c = ind->codigos + (size_t) i * m;
+    float soma = 0;
+    for (int j = 0; j < m; j++) soma += tabela[j * 256 + c[j]];
+    limite = inserir(h, soma, i, limite);
+  }
+}
+
+// Soma, para os 16 pontos de um bloco, as consultas às tabelas quantizadas
+static void somar_bloco(const uint8_t *bloco, const uint8_t *tq, int pares, uint16_t *acc) {
+#ifdef __SSSE3__
+  const __m128i mascara = _mm_set1_epi8(0x0f);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc_lo = zero, acc_hi = zero;
+  for (int p = 0; p < pares; p++) {
+    __m128i v = _mm_loadu_si128((const __m128i*) (bloco + p * 16));
+    __m128i lo = _mm_and_si128(v, mascara);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mascara);
+    __m128i d0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (tq + 2 * p * 16)), lo);
+    __m128i d1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (tq + (2 * p + 1) * 16)), hi);
+    acc_lo = _mm_add_epi16(acc_lo, _mm_unpacklo_epi8(d0, zero));
+    acc_hi = _mm_add_epi16(acc_hi, _mm_unpackhi_epi8(d0, zero));
+    acc_lo = _mm_add_epi16(acc_lo, _mm_unpacklo_epi8(d1, zero));
+    acc_hi = _mm_add_epi16(acc_hi, _mm_unpackhi_epi8(d1, zero));
+  }
+  _mm_storeu_si128((__m128i*) acc, acc_lo);
+  _mm_storeu_si128((__m128i*) (acc + 8), acc_hi);
+#else
+  for (int l = 0; l < 16; l++) {
+    unsigned soma = 0;
+    for (int p = 0; p < pares; p++) {
+      uint8_t b = bloco[p * 16 + l];
+      soma += tq[2 * p * 16 + (b & 0x0f)] + tq[(2 * p + 1) * 16 + (b >> 4)];
+    }
+    acc[l] = (uint16_t) soma;
+  }
+#endif
+}
+
+static void varrer_4bits(const IndicePQ *ind, const float *tabela, uint8_t *tq, Heap *h) {
+  int m = ind->cod.m;
+  int pares = m / 2;
+
+  // Tabelas quantizadas para 8 bits com escala comum, somando a base de cada uma
+  float base = 0, amplitude = 0;
+  for (int j = 0; j < m; j++) {
+    float menor = FLT_MAX, maior = 0;
+    for (int c = 0; c < 16; c++) {
+      float v = tabela[j * 16 + c];
+      if (v < menor) menor = v;
+      if (v > maior) maior = v;
+    }
+    base += menor;
+    if (maior - menor > amplitude) amplitude = maior - menor;
+  }
+  float escala = amplitude > 0 ? 255.0f / amplitude : 0;
+  for (int j = 0; j < m; j++) {
+    float menor = FLT_MAX;
+    for (int c = 0; c < 16; c++) {
+      if (tabela[j * 16 + c] < menor) menor = tabela[j * 16 + c];
+    }
+    for (int c = 0; c < 16; c++) {
+      tq[j * 16 + c] = (uint8_t) ((tabela[j * 16 + c] - menor) * escala + 0.5f);
+    }
+  }
+
+  uint16_t acc[PQ_PONTOS_POR_BLOCO];
+  float limite = FLT_MAX;
+  int blocos = (ind->N + PQ_PONTOS_POR_BLOCO - 1) / PQ_PONTOS_POR_BLOCO;
+  for (int b = 0; b < blocos; b++) {
+    somar_bloco(ind->codigos + (size_t) b * pares * PQ_PONTOS_POR_BLOCO, tq, pares, acc);
+    int i0 = b * PQ_PONTOS_POR_BLOCO;
+    int n = ind->N - i0 < PQ_PONTOS_POR_BLOCO ? ind->N - i0 : PQ_PONTOS_POR_BLOCO;
+    for (int l = 0; l < n; l++) {
+      float d2 = escala > 0 ? base + acc[l] / escala : base;
+      limite = inserir(h, d2, i0 + l, limite);
+    }
+  }
+}
+
+void pq_varrer(const IndicePQ *indice, const float *tabela, uint8_t *rascunho, Heap *h) {
+  if (indice->cod.bits == 8) {
+    varrer_8bits(indice, tabela, h);
+  } else {
+    varrer_4bits(indice, tabela, rascunho, h);
+  }
+}
+
+size_t pq_bytes_codigos(const IndicePQ *indice) {
+  if (indice->cod.bits == 8) return (size_t) indice->N * indice->cod.m;
+  size_t blocos = ((size_t) indice->N + PQ_PONTOS_POR_BLOCO - 1) / PQ_PONTOS_POR_BLOCO;
+  return blocos * (indice->cod.m / 2) * PQ_PONTOS_POR_BLOCO;
+}
+
+void pq_libera(IndicePQ *indice) {
+  free(indice->cod.centroides);
+  free(indice->codigos);
+  free(indice->ids);
+  indice->cod.centroides = NULL;
+  indice->codigos = NULL;
+  indice->ids = NULL;
+  indice->N = 0;
+}
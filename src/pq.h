@@ -0,0 +1,133 @@
+/**
+ * @file pq.h
+ * @brief Quantização por produto (PQ) com tabelas de distância assimétricas.
+ *
+ * Cada vetor de D dimensões é dividido em `m` subvetores de `D / m`
+ * dimensões, e cada subvetor é substituído pelo índice do centróide mais
+ * próximo em um dicionário próprio do subespaço, treinado por k-means. Um
+ * ponto de treino passa a ocupar `m` bytes (8 bits por subespaço) ou `m / 2`
+ * bytes (4 bits).
+ *
+ * Na busca, a consulta não é quantizada (distância assimétrica, ADC): para
+ * cada subespaço calcula-se uma tabela com a distância ao quadrado entre o
+ * subvetor da consulta e cada centróide, e a distância aproximada até um
+ * ponto é a soma de `m` consultas a essas tabelas.
+ *
+ * Com 4 bits, cada tabela tem 16 entradas e cabe em um registrador SSE: as
+ * tabelas são quantizadas para 8 bits e as consultas são feitas 16 pontos
+ * por vez com `_mm_shuffle_epi8` (SSSE3). Para isso os códigos de 4 bits são
+ * guardados em blocos de 16 pontos: para cada par de subespaços `(j, j+1)`,
+ * 16 bytes, um por ponto, com o código de `j` no nibble baixo e o de `j+1`
+ * no alto. Sem SSSE3 o mesmo cálculo inteiro é feito de forma escalar, com
+ * resultado idêntico.
+ */
+
+#ifndef PQ_H
+#define PQ_H
+
+#include <stdint.h>
+
+#include "formato.h"
+#include "heap.h"
+#include "knn.h"
+#include "pool.h"
+
+#define PQ_PONTOS_POR_BLOCO 16 /**< Pontos por bloco no layout de 4 bits. */
+
+/**
+ * @brief Dicionários de centróides de todos os subespaços.
+ */
+typedef struct {
+  int D;             /**< Dimensões dos vetores. */
+  int m;             /**< Número de subespaços. */
+  int dsub;          /**< Dimensões por subespaço (`D / m`). */
+  int bits;          /**< Bits por código (4 ou 8). */
+  int ksub;          /**< Centróides por subespaço (`1 << bits`). */
+  float *centroides; /**< `m * ksub * dsub` coordenadas. */
+} CodificadorPQ;
+
+/**
+ * @brief Treino codificado.
+ */
+typedef struct {
+  CodificadorPQ cod; /**< Dicionários usados na codificação. */
+  int N;             /**< Número de pontos codificados. */
+  int *ids;          /**< Id de cada ponto. */
+  uint8_t *codigos;  /**< Códigos (layout em pq.h). */
+} IndicePQ;
+
+/**
+ * @brief Treina os dicionários e codifica o treino.
+ *
+ * @details Os subespaços são treinados em paralelo pelas threads do pool,
+ * com k-means sobre uma amostra do treino; a codificação dos pontos também
+ * é dividida entre as threads.
+ *
+ * @param indice Índice a ser preenchido.
+ * @param treino Pontos de treino.
+ * @param N Número de pontos (pelo menos `1 << bits`).
+ * @param D Número de dimensões (múltiplo de `m`).
+ * @param m Número de subespaços (par quando `bits` = 4).
+ * @param bits Bits por código: 4 ou 8.
+ * @param pool Threads de trabalho.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int pq_construir(IndicePQ *indice, const Ponto *treino, int N, int D, int m, int bits,
+                 Pool *pool);
+
+/**
+ * @brief Treina os dicionários e codifica o treino lendo-o do disco.
+ *
+ * @details Nunca mantém o treino inteiro em memória: o k-means usa só a
+ * amostra (`ksub * 32` linhas, lidas uma a uma com formato_ler_linha()), e a
+ * codificação lê o arquivo em lotes contíguos com formato_ler_pontos(),
+ * liberando cada lote antes do próximo. O resultado é o mesmo de
+ * pq_construir() com o treino carregado.
+ *
+ * @param indice Índice a ser preenchido.
+ * @param arq Dataset aberto por formato_abrir() (`n` pontos de `d` dimensões).
+ * @param m Número de subespaços (divide `d`; par quando `bits` = 4).
+ * @param bits Bits por código: 4 ou 8.
+ * @param pool Threads de trabalho.
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int pq_construir_arquivo(IndicePQ *indice, ArquivoDataset *arq, int m, int bits, Pool *pool);
+
+/**
+ * @brief Tamanho, em floats, da tabela de distâncias de uma consulta.
+ */
+int pq_tamanho_tabela(const CodificadorPQ *cod);
+
+/**
+ * @brief Calcula a tabela de distâncias ao quadrado de uma consulta.
+ *
+ * @param cod Dicionários.
+ * @param q Coordenadas da consulta.
+ * @param tabela Vetor com pq_tamanho_tabela() floats.
+ */
+void pq_tabela(const CodificadorPQ *cod, const double *q, float *tabela);
+
+/**
+ * @brief Percorre todos os códigos e guarda em `h` os mais próximos.
+ *
+ * @details Insere na heap a distância aproximada (já com raiz) e o índice do
+ * ponto no treino codificado (não o id), para permitir o re-ranqueamento.
+ *
+ * @param indice Treino codificado.
+ * @param tabela Tabela calculada por pq_tabela().
+ * @param rascunho Buffer com `m * 16` bytes (usado só com 4 bits).
+ * @param h Heap vazia com a capacidade de candidatos desejada.
+ */
+void pq_varrer(const IndicePQ *indice, const float *tabela, uint8_t *rascunho, Heap *h);
+
+/**
+ * @brief Memória ocupada pelos códigos, em bytes.
+ */
+size_t pq_bytes_codigos(const IndicePQ *indice);
+
+/**
+ * @brief Libera a memória do índice.
+ */
+void pq_libera(IndicePQ *indice);
+
+#endif // !PQ_H
@@ -0,0 +1,384 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "heap.h"
+#include "raio.h"
+#include "trace.h"
+#include "utils.h"
+
+#define BUFFER_RAIO_INICIAL 1024
+
+/**
+ * @brief Um par (ponto de teste, vizinho) encontrado por uma thread.
+ */
+typedef struct {
+  int consulta; /**< Índice do ponto de teste. */
+  int id;       /**< Id global do ponto de treino. */
+  double dist;  /**< Distância entre os dois pontos. */
+} ParRaio;
+
+/**
+ * @brief Estado de cada thread da busca por raio.
+ *
+ * @details Na busca, `contagem[q]` conta os pares da thread para a consulta
+ * `q`; na combinação, passa a guardar a próxima posição de escrita desses
+ * pares no vetor combinado.
+ */
+typedef struct {
+  Dataset *dataset;   /**< Dataset com treino e teste. */
+  const IndiceNormas *indice; /**< Índice por norma do treino (ou NULL). */
+  Ponto *ini;         /**< Início da fatia de treino da thread. */
+  int n;              /**< Quantidade de pontos da fatia. */
+  double raio2;       /**< Quadrado do raio. */
+  int max;            /**< Limite por consulta (0 = sem limite). */
+  ParRaio *pares;     /**< Buffer de pares encontrados. */
+  int64_t n_pares;    /**< Pares no buffer. */
+  int64_t cap;        /**< Capacidade do buffer. */
+  int64_t *contagem;  /**< Contagem (depois, posição) por consulta. */
+  HeapElem *combinado;/**< Vetor combinado de todas as threads. */
+  int q_ini, q_fim;   /**< Faixa de consultas (busca pelo índice e ordenação). */
+  const int64_t *brutos; /**< Offsets no vetor combinado. */
+  ResultadoRaio *res; /**< Resultado final. */
+  int erro;           /**< Diferente de zero se a thread falhou. */
+} RaioArgs;
+
+static int buffer_anexar(RaioArgs *arg, int consulta, int id, double dist) {
+  if (arg->n_pares == arg->cap) {
+    int64_t nova_cap = arg->cap ? 2 * arg->cap : BUFFER_RAIO_INICIAL;
+    ParRaio *novo = (ParRaio*) realloc(arg->pares, nova_cap * sizeof(ParRaio));
+    if (!novo) return -1;
+    arg->pares = novo;
+    arg->cap = nova_cap;
+  }
+  arg->pares[arg->n_pares++] = (ParRaio){consulta, id, dist};
+  arg->contagem[consulta]++;
+  return 0;
+}
+
+// Heaps de capacidade `cap` que aplicam o limite por consulta já na busca
+static Heap *criar_heaps(int n, int cap) {
+  Heap *heaps = (Heap*) malloc((n > 0 ? n : 1) * sizeof(Heap));
+  if (!heaps) return NULL;
+  for (int i = 0; i < n; i++) {
+    heap_init(&heaps[i], cap);
+    if (!heaps[i].data) {
+      for (int j = 0; j <= i; j++) heap_libera(&heaps[j]);
+      free(heaps);
+      return NULL;
+    }
+  }
+  return heaps;
+}
+
+static void liberar_heaps(Heap *heaps, int n) {
+  if (!heaps) return;
+  for (int i = 0; i < n; i++) heap_libera(&heaps[i]);
+  free(heaps);
+}
+
+// Passa para o buffer os vizinhos que sobraram na heap de uma consulta
+static int anexar_heap(RaioArgs *arg, int consulta, Heap *h) {
+  for (int k = 0; k < h->n_elem; k++) {
+    if (buffer_anexar(arg, consulta, h->data[k].id, h->data[k].dist) != 0) return -1;
+  }
+  h->n_elem = 0;
+  return 0;
+}
+
+// Etapa 1: cada thread compara sua fatia de treino com todos os pontos de teste.
+// Com limite, cada consulta tem uma heap própria da thread, e só o que sobra
+// nela vai para o buffer
+static void *raio_worker(void *args) {
+  RaioArgs *arg = (RaioArgs*) args;
+  Dataset *ds = arg->dataset;
+  int64_t ini = arg->ini - ds->treino;
+  Heap *heaps = NULL;
+  if (arg->max > 0 && !(heaps = criar_heaps(ds->M, arg->max))) {
+    fprintf(stderr, "Erro de alocação de memória nas heaps de raio\n");
+    arg->erro = 1;
+    return NULL;
+  }
+  trace_inicio_faixa("fatia", ini, ini + arg->n);
+
+  for (int i = 0; i < arg->n && !arg->erro; i++) {
+    Ponto *p_ponto_treino = arg->ini + i;
+    for (int j = 0; j < ds->M; j++) {
+      // A soma é abandonada assim que passa do raio
+      double d2 = distancia2_limitada(p_ponto_treino, ds->teste + j, ds->D, arg->raio2);
+      if (d2 > arg->raio2) continue;
+      if (heaps) {
+        heap_inserir(&heaps[j], sqrt(d2), p_ponto_treino->id);
+      } else if (buffer_anexar(arg, j, p_ponto_treino->id, sqrt(d2)) != 0) {
+        fprintf(stderr, "Erro de alocação de memória no buffer de raio\n");
+        arg->erro = 1;
+        break;
+      }
+    }
+  }
+
+  for (int j = 0; heaps && j < ds->M && !arg->erro; j++) {
+    if (anexar_heap(arg, j, &heaps[j]) != 0) {
+      fprintf(stderr, "Erro de alocação de memória no buffer de raio\n");
+      arg->erro = 1;
+    }
+  }
+  trace_fim("fatia");
+  liberar_heaps(heaps, ds->M);
+  return NULL;
+}
+
+// Etapa 1 com o índice: cada thread percorre, para cada consulta da sua
+// faixa, só os pontos de treino cuja norma pode estar dentro do raio
+static void *raio_worker_indice(void *args) {
+  RaioArgs *arg = (RaioArgs*) args;
+  Dataset *ds = arg->dataset;
+  double raio = sqrt(arg->raio2);
+  // A thread tem a consulta inteira: com limite, basta uma heap reaproveitada
+  Heap *heap = NULL;
+  if (arg->max > 0 && !(heap = criar_heaps(1, arg->max))) {
+    fprintf(stderr, "Erro de alocação de memória nas heaps de raio\n");
+    arg->erro = 1;
+    return NULL;
+  }
+  trace_inicio_faixa("consultas", arg->q_ini, arg->q_fim);
+
+  for (int j = arg->q_ini; j < arg->q_fim && !arg->erro; j++) {
+    int ini, fim;
+    indice_normas_faixa(arg->indice, ds->teste + j, ds->D, raio, &ini, &fim);
+    for (int p = ini; p < fim; p++) {
+      const Ponto *t = ds->treino + arg->indice->ordem[p];
+      double d2 = distancia2_limitada(t, ds->teste + j, ds->D, arg->raio2);
+      if (d2 > arg->raio2) continue;
+      if (heap) {
+        heap_inserir(heap, sqrt(d2), t->id);
+      } else if (buffer_anexar(arg, j, t->id, sqrt(d2)) != 0) {
+        fprintf(stderr, "Erro de alocação de memória no buffer de raio\n");
+        arg->erro = 1;
+        break;
+      }
+    }
+    if (heap && anexar_heap(arg, j, heap) != 0) {
+      fprintf(stderr, "Erro de alocação de memória no buffer de raio\n");
+      arg->erro = 1;
+    }
+  }
+  trace_fim("consultas");
+  liberar_heaps(heap, 1);
+  return NULL;
+}
+
+// Etapa 2: cada thread copia seus pares para as posições reservadas a ela
+static void *raio_espalhar(void *args) {
+  RaioArgs *arg = (RaioArgs*) args;
+  trace_inicio("combinacao");
+  for (int64_t k = 0; k < arg->n_pares; k++) {
+    const ParRaio *p = &arg->pares[k];
+    arg->combinado[arg->contagem[p->consulta]++] = (HeapElem){p->dist, p->id};
+  }
+  trace_fim("combinacao");
+  return NULL;
+}
+
+// Etapa 3: ordena cada consulta, aplica o limite entre as threads e grava
+// no CSR final
+static void *raio_ordenar(void *args) {
+  RaioArgs *arg = (RaioArgs*) args;
+  ResultadoRaio *res = arg->res;
+  trace_inicio_faixa("ordenacao", arg->q_ini, arg->q_fim);
+  for (int q = arg->q_ini; q < arg->q_fim; q++) {
+    HeapElem *seg = arg->combinado + arg->brutos[q];
+    int64_t n = arg->brutos[q + 1] - arg->brutos[q];
+    qsort(seg, n, sizeof(HeapElem), heap_comparar_elem);
+    int64_t base = res->offsets[q];
+    for (int64_t k = 0; k < res->offsets[q + 1] - base; k++) {
+      res->ids[base + k] = seg[k].id;
+      res->dists[base + k] = seg[k].dist;
+    }
+  }
+  trace_fim("ordenacao");
+  return NULL;
+}
+
+static int disparar(RaioArgs *args, int num_threads, void *(*rotina)(void*)) {
+  pthread_t *threads = (pthread_t*) malloc(num_threads * sizeof(pthread_t));
+  if (!threads) {
+    fprintf(stderr, "Erro de alocação de memória para threads\n");
+    return -1;
+  }
+  int ret = 0;
+  int criadas = 0;
+  for (; criadas < num_threads; criadas++) {
+    if (pthread_create(&threads[criadas], NULL, rotina, &args[criadas]) != 0) {
+      fprintf(stderr, "Erro ao criar thread %d\n", criadas);
+      ret = -1;
+      break;
+    }
+  }
+  for (int i = 0; i < criadas; i++) {
+    pthread_join(threads[i], NULL);
+    if (args[i].erro) ret = -1;
+  }
+  free(threads);
+  return ret;
+}
+
+int raio_executar(Dataset *dataset, const IndiceNormas *indice, double raio,
+                  int max_por_consulta, int num_threads, ResultadoRaio *res) {
+  int M = dataset->M;
+  memset(res, 0, sizeof(*res));
+  res->M = M;
+  res->raio = raio;
+
+  RaioArgs *args = (RaioArgs*) calloc(num_threads, sizeof(RaioArgs));
+  int64_t *brutos = (int64_t*) calloc(M + 1, sizeof(int64_t));
+  res->offsets = (int64_t*) calloc(M + 1, sizeof(int64_t));
+  if (!args || !brutos || !res->offsets) goto erro_memoria;
+
+  int pontos_por_thread = dataset->N / num_threads;
+  int pontos_restantes = dataset->N % num_threads;
+  int consultas_por_thread = M / num_threads;
+  int consultas_restantes = M % num_threads;
+  for (int t = 0; t < num_threads; t++) {
+    args[t].dataset = dataset;
+    args[t].indice = indice;
+    args[t].q_ini = t * consultas_por_thread;
+    args[t].q_fim = args[t].q_ini + consultas_por_thread +
+                    (t == num_threads - 1 ? consultas_restantes : 0);
+    args[t].ini = dataset->treino + t * pontos_por_thread;
+    args[t].n = pontos_por_thread + (t == num_threads - 1 ? pontos_restantes : 0);
+    args[t].raio2 = raio * raio;
+    args[t].max = max_por_consulta > 0 ? max_por_consulta : 0;
+    args[t].brutos = brutos;
+    args[t].res = res;
+    args[t].contagem = (int64_t*) calloc(M > 0 ? M : 1, sizeof(int64_t));
+    if (!args[t].contagem) goto erro_memoria;
+  }
+
+  // Com o índice as threads dividem as consultas; sem ele, o treino
+  if (disparar(args, num_threads, indice ? raio_worker_indice : raio_worker) != 0) goto erro;
+
+  // Offsets brutos (todos os pares) e finais (após o limite por consulta)
+  for (int q = 0; q < M; q++) {
+    int64_t n = 0;
+    for (int t = 0; t < num_threads; t++) {
+      // A contagem da thread vira a posição onde seus pares começam
+      int64_t c = args[t].contagem[q];
+      args[t].contagem[q] = brutos[q] + n;
+      n += c;
+    }
+    brutos[q + 1] = brutos[q] + n;
+    if (max_por_consulta > 0 && n > max_por_consulta) n = max_por_consulta;
+    res->offsets[q + 1] = res->offsets[q] + n;
+  }
+  res->total = res->offsets[M];
+
+  HeapElem *combinado = (HeapElem*) malloc((brutos[M] > 0 ? brutos[M] : 1) * sizeof(HeapElem));
+  res->ids = (int64_t*) malloc((res->total > 0 ? res->total : 1) * sizeof(int64_t));
+  res->dists = (double*) malloc((res->total > 0 ? res->total : 1) * sizeof(double));
+  if (!combinado || !res->ids || !res->dists) {
+    free(combinado);
+    goto erro_memoria;
+  }
+
+  for (int t = 0; t < num_threads; t++) args[t].combinado = combinado;
+
+  int ret = disparar(args, num_threads, raio_espalhar);
+  if (ret == 0) ret = disparar(args, num_threads, raio_ordenar);
+  free(combinado);
+  if (ret != 0) goto erro;
+
+  for (int t = 0; t < num_threads; t++) {
+    free(args[t].pares);
+    free(args[t].contagem);
+  }
+  free(args);
+  free(brutos);
+  return 0;
+
+erro_memoria:
+  fprintf(stderr, "Erro de alocação de memória na busca por raio\n");
+erro:
+  if (args) {
+    for (int t = 0; t < num_threads; t++) {
+      free(args[t].pares);
+      free(args[t].contagem);
+    }
+  }
+  free(args);
+  free(brutos);
+  raio_libera(res);
+  return -1;
+}
+
+int raio_salvar_texto(const ResultadoRaio *res, const char *filename) {
+  FILE *file = fopen(filename, "w");
+  if (!file) {
+    fprintf(stderr, "Erro ao criar arquivo de saída %s\n", filename);
+    return -1;
+  }
+
+  fprintf(file, "Resultados da busca por raio (r=%.6f)\n", res->raio);
+  fprintf(file, "==============================\n\n");
+
+  for (int q = 0; q < res->M; q++) {
+    fprintf(file, "Ponto de teste %d:\n", q);
+    fprintf(file, "Vizinhos dentro do raio (%lld):\n",
+            (long long) (res->offsets[q + 1] - res->offsets[q]));
+    for (int64_t k = res->offsets[q]; k < res->offsets[q + 1]; k++) {
+      fprintf(file, "  ID: %lld, Distância: %.6f\n", (long long) res->ids[k],
+              res->dists[k]);
+    }
+    fprintf(file, "\n");
+  }
+
+  if (fclose(file) != 0) {
+    fprintf(stderr, "Erro ao gravar %s\n", filename);
+    return -1;
+  }
+  printf("Resultados salvos em %s\n", filename);
+  return 0;
+}
+
+int raio_salvar_csr(const ResultadoRaio *res, int max_por_consulta,
+                    const char *filename) {
+  FILE *file = fopen(filename, "wb");
+  if (!file) {
+    fprintf(stderr, "Erro ao criar arquivo de saída %s\n", filename);
+    return -1;
+  }
+
+  CabecalhoRaio cab;
+  memset(&cab, 0, sizeof(cab));
+  memcpy(cab.magico, RAIO_MAGICO, 4);
+  cab.versao = RAIO_VERSAO;
+  cab.m = res->M;
+  cab.max_por_consulta = max_por_consulta > 0 ? max_por_consulta : 0;
+  cab.raio = res->raio;
+  cab.total = res->total;
+
+  int ok = fwrite(&cab, sizeof(cab), 1, file) == 1 &&
+           fwrite(res->offsets, sizeof(int64_t), res->M + 1, file) == (size_t) res->M + 1 &&
+           fwrite(res->ids, sizeof(int64_t), res->total, file) == (size_t) res->total &&
+           fwrite(res->dists, sizeof(double), res->total, file) == (size_t) res->total;
+  if (fclose(file) != 0) ok = 0;
+  if (!ok) {
+    fprintf(stderr, "Erro ao gravar %s\n", filename);
+    return -1;
+  }
+  printf("Resultado CSR salvo em %s\n", filename);
+  return 0;
+}
+
+void raio_libera(ResultadoRaio *res) {
+  free(res->offsets);
+  free(res->ids);
+  free(res->dists);
+  res->offsets = NULL;
+  res->ids = NULL;
+  res->dists = NULL;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file raio.h
+ * @brief Busca por raio: todos os pontos de treino a distância `<= r`.
+ *
+ * Ao contrário do KNN, o número de resultados por ponto de teste não é
+ * conhecido de antemão, então a ::Heap de capacidade fixa não serve. Cada
+ * thread percorre sua fatia do treino (como no thread_worker()) e acumula os
+ * pares encontrados em um buffer próprio que cresce sob demanda, sem nenhuma
+ * trava. Ao final, os buffers são combinados em um resultado compacto no
+ * estilo CSR: `offsets[q] .. offsets[q + 1]` delimita, em `ids` e `dists`,
+ * os vizinhos do ponto de teste `q`, em ordem crescente de distância.
+ *
+ * Com limite de `C` vizinhos por consulta, o limite já vale durante a busca:
+ * cada thread guarda os candidatos em heaps de capacidade `C`, e o buffer
+ * recebe só o que sobrou nelas. A memória fica em `O(threads * M * C)`, e
+ * não proporcional a todos os pares dentro do raio.
+ */
+
+#ifndef RAIO_H
+#define RAIO_H
+
+#include <stdint.h>
+
+#include "indice.h"
+#include "knn.h"
+
+#define RAIO_MAGICO "KNNR" /**< Número mágico dos arquivos CSR de raio. */
+#define RAIO_VERSAO 1      /**< Versão atual do formato CSR de raio. */
+
+/**
+ * @brief Resultado de uma busca por raio no formato CSR.
+ */
+typedef struct {
+  int M;            /**< Número de pontos de teste. */
+  double raio;      /**< Raio usado na busca. */
+  int64_t total;    /**< Número total de vizinhos encontrados. */
+  int64_t *offsets; /**< `M + 1` offsets para `ids` e `dists`. */
+  int64_t *ids;     /**< Ids globais dos vizinhos. */
+  double *dists;    /**< Distâncias dos vizinhos. */
+} ResultadoRaio;
+
+/**
+ * @brief Cabeçalho de 32 bytes do arquivo CSR de raio.
+ *
+ * @details Seguido por `M + 1` offsets `int64_t`, `total` ids `int64_t` e
+ * `total` distâncias `double`.
+ */
+typedef struct {
+  char magico[4];    /**< `"KNNR"`. */
+  uint16_t versao;   /**< Versão do formato. */
+  uint16_t reservado; /**< Sempre zero. */
+  uint32_t m;        /**< Número de pontos de teste. */
+  uint32_t max_por_consulta; /**< Limite por consulta (0 = sem limite). */
+  double raio;       /**< Raio usado na busca. */
+  uint64_t total;    /**< Número total de vizinhos. */
+} CabecalhoRaio;
+
+/**
+ * @brief Executa a busca por raio com `num_threads` threads.
+ *
+ * @details Sem índice, cada thread compara sua fatia do treino com todas as
+ * consultas. Com o índice por norma, as threads dividem as consultas e cada
+ * uma só compara os pontos de treino da indice_normas_faixa() da consulta;
+ * o resultado é o mesmo.
+ *
+ * @param dataset Dataset com treino e teste carregados.
+ * @param indice Índice por norma construído sobre `dataset->treino`, ou NULL
+ *        para a força bruta.
+ * @param raio Raio da busca.
+ * @param max_por_consulta Se positivo, mantém apenas os mais próximos
+ *        de cada ponto de teste até esse limite; sem índice, cada thread
+ *        aloca uma heap desse tamanho por ponto de teste.
+ * @param num_threads Número de threads.
+ * @param res Resultado a ser preenchido (liberar com raio_libera()).
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int raio_executar(Dataset *dataset, const IndiceNormas *indice, double raio,
+                  int max_por_consulta, int num_threads, ResultadoRaio *res);
+
+/**
+ * @brief Salva o resultado no formato texto, no estilo de `output.txt`.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int raio_salvar_texto(const ResultadoRaio *res, const char *filename);
+
+/**
+ * @brief Salva o resultado no formato binário CSR (ver ::CabecalhoRaio).
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int raio_salvar_csr(const ResultadoRaio *res, int max_por_consulta,
+                    const char *filename);
+
+/**
+ * @brief Libera a memória de um resultado de busca por raio.
+ */
+void raio_libera(ResultadoRaio *res);
+
+#endif // !RAIO_H
@@ -0,0 +1,175 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "trace.h"
+
+/**
+ * @brief Um evento de início ('B') ou fim ('E') de fase.
+ */
+typedef struct {
+  const char *nome;
+  double ts;        /* microssegundos desde trace_iniciar() */
+  int64_t ini;      /* faixa do evento (ini > fim = sem faixa) */
+  int64_t fim;
+  char fase;
+} EventoTrace;
+
+/**
+ * @brief Buffer circular de uma thread.
+ */
+typedef struct {
+  EventoTrace *eventos;
+  uint64_t escritos;  /* total de eventos já registrados (só a dona escreve) */
+  int livre;          /* 1 quando a thread dona terminou e o buffer pode ser reusado */
+} BufferTrace;
+
+static int ligado = 0;
+static struct timespec zero;
+static pthread_key_t chave;
+static BufferTrace buffers[TRACE_MAX_THREADS];
+static int n_buffers = 0;
+static int sem_buffer = 0;  /* threads que não couberam em TRACE_MAX_THREADS */
+
+// Chamado quando a thread dona termina: a linha dela pode passar a outra thread
+static void liberar_buffer(void *arg) {
+  BufferTrace *b = (BufferTrace*) arg;
+  // Barreira completa: os eventos da dona ficam visíveis a quem reusar o buffer
+  __sync_bool_compare_and_swap(&b->livre, 0, 1);
+}
+
+static BufferTrace *registrar(void) {
+  // Reusa o buffer de uma thread que já terminou, se houver
+  int n = __sync_fetch_and_add(&n_buffers, 0);
+  if (n > TRACE_MAX_THREADS) n = TRACE_MAX_THREADS;
+  for (int i = 0; i < n; i++) {
+    if (__sync_bool_compare_and_swap(&buffers[i].livre, 1, 0)) {
+      pthread_setspecific(chave, &buffers[i]);
+      return &buffers[i];
+    }
+  }
+
+  int i = __sync_fetch_and_add(&n_buffers, 1);
+  if (i >= TRACE_MAX_THREADS) {
+    __sync_fetch_and_add(&sem_buffer, 1);
+    return NULL;
+  }
+  BufferTrace *b = &buffers[i];
+  b->eventos = (EventoTrace*) malloc(TRACE_EVENTOS_POR_THREAD * sizeof(EventoTrace));
+  if (!b->eventos) {
+    __sync_fetch_and_add(&sem_buffer, 1);
+    return NULL;
+  }
+  pthread_setspecific(chave, b);
+  return b;
+}
+
+static void registrar_evento(const char *nome, char fase, int64_t ini, int64_t fim) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  BufferTrace *b = (BufferTrace*) pthread_getspecific(chave);
+  if (!b && !(b = registrar())) return;
+
+  EventoTrace *e = &b->eventos[b->escritos % TRACE_EVENTOS_POR_THREAD];
+  e->nome = nome;
+  e->ts = (t.tv_sec - zero.tv_sec) * 1e6 + (t.tv_nsec - zero.tv_nsec) / 1e3;
+  e->ini = ini;
+  e->fim = fim;
+  e->fase = fase;
+  b->escritos++;
+}
+
+int trace_iniciar(void) {
+  if (ligado) return 0;
+  if (pthread_key_create(&chave, liberar_buffer) != 0) {
+    fprintf(stderr, "Erro ao iniciar o tracer\n");
+    return -1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &zero);
+  ligado = 1;
+  return 0;
+}
+
+void trace_inicio(const char *nome) {
+  if (ligado) registrar_evento(nome, 'B', 0, -1);
+}
+
+void trace_inicio_faixa(const char *nome, int64_t ini, int64_t fim) {
+  if (ligado) registrar_evento(nome, 'B', ini, fim);
+}
+
+void trace_fim(const char *nome) {
+  if (ligado) registrar_evento(nome, 'E', 0, -1);
+}
+
+int trace_gravar(const char *arquivo) {
+  if (!ligado) return 0;
+  __sync_synchronize();
+
+  FILE *f = fopen(arquivo, "w");
+  if (!f) {
+    fprintf(stderr, "Erro ao criar arquivo de trace %s\n", arquivo);
+    return -1;
+  }
+
+  int n = n_buffers < TRACE_MAX_THREADS ? n_buffers : TRACE_MAX_THREADS;
+  uint64_t perdidos = 0;
+  int primeiro = 1;
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for (int i = 0; i < n; i++) {
+    BufferTrace *b = &buffers[i];
+    if (!b->eventos) continue;
+    fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+            "\"args\":{\"name\":\"thread %d\"}}", primeiro ? "" : ",\n", i, i);
+    primeiro = 0;
+
+    // Só os últimos TRACE_EVENTOS_POR_THREAD eventos continuam no buffer
+    uint64_t ini = 0;
+    if (b->escritos > TRACE_EVENTOS_POR_THREAD) {
+      ini = b->escritos - TRACE_EVENTOS_POR_THREAD;
+      perdidos += ini;
+    }
+    for (uint64_t k = ini; k < b->escritos; k++) {
+      const EventoTrace *e = &b->eventos[k % TRACE_EVENTOS_POR_THREAD];
+      fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"knn\",\"ph\":\"%c\",\"ts\":%.3f,"
+              "\"pid\":1,\"tid\":%d", e->nome, e->fase, e->ts, i);
+      if (e->ini <= e->fim) {
+        fprintf(f, ",\"args\":{\"ini\":%lld,\"fim\":%lld}", (long long) e->ini,
+                (long long) e->fim);
+      }
+      fprintf(f, "}");
+    }
+  }
+  fprintf(f, "\n]}\n");
+  if (fclose(f) != 0) {
+    fprintf(stderr, "Erro ao gravar arquivo de trace %s\n", arquivo);
+    return -1;
+  }
+
+  if (perdidos > 0) {
+    fprintf(stderr, "Aviso: %llu eventos antigos foram sobrescritos no trace\n",
+            (unsigned long long) perdidos);
+  }
+  if (sem_buffer > 0) {
+    fprintf(stderr, "Aviso: %d threads ficaram fora do trace\n", sem_buffer);
+  }
+  printf("Trace salvo em %s\n", arquivo);
+  return 0;
+}
+
+void trace_encerrar(void) {
+  if (!ligado) return;
+  ligado = 0;
+  int n = n_buffers < TRACE_MAX_THREADS ? n_buffers : TRACE_MAX_THREADS;
+  for (int i = 0; i < n; i++) {
+    free(buffers[i].eventos);
+    buffers[i] = (BufferTrace){NULL, 0, 0};
+  }
+  n_buffers = 0;
+  sem_buffer = 0;
+  pthread_key_delete(chave);
+}
@@ -0,0 +1,65 @@
+/**
+ * @file trace.h
+ * @brief Linha do tempo por thread no formato trace-event do Chrome.
+ *
+ * Cada thread que registra um evento ganha, na primeira vez, um buffer
+ * circular próprio; a gravação de um evento só escreve nesse buffer, sem
+ * travas nem operações atômicas. Quando o buffer enche, os eventos mais
+ * antigos são sobrescritos. Com o tracer desligado, cada chamada custa só o
+ * teste de uma variável global.
+ *
+ * O resultado é gravado em JSON por trace_gravar() e pode ser aberto em
+ * `chrome://tracing` ou em https://ui.perfetto.dev: uma linha por thread,
+ * com uma barra para cada fase (leitura, heaps, fatias, blocos, combinação,
+ * saída...).
+ *
+ * Os nomes dos eventos devem ser literais (ou viver até a gravação): só o
+ * ponteiro é guardado.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_EVENTOS_POR_THREAD (1 << 16) /**< Capacidade de cada buffer circular. */
+#define TRACE_MAX_THREADS 256              /**< Threads simultâneas rastreadas. */
+
+/**
+ * @brief Liga o tracer; o instante da chamada é o zero da linha do tempo.
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int trace_iniciar(void);
+
+/**
+ * @brief Abre uma fase na thread atual.
+ */
+void trace_inicio(const char *nome);
+
+/**
+ * @brief Abre uma fase que cobre a faixa `[ini, fim)` (de pontos, consultas...).
+ */
+void trace_inicio_faixa(const char *nome, int64_t ini, int64_t fim);
+
+/**
+ * @brief Fecha a fase `nome` aberta por último na thread atual.
+ */
+void trace_fim(const char *nome);
+
+/**
+ * @brief Grava os eventos de todas as threads em JSON.
+ *
+ * @details Deve ser chamada quando nenhuma outra thread estiver registrando
+ * eventos (por exemplo, com os pools ociosos ou destruídos).
+ *
+ * @return 0 em caso de sucesso, -1 em caso de erro.
+ */
+int trace_gravar(const char *arquivo);
+
+/**
+ * @brief Desliga o tracer e libera os buffers.
+ */
+void trace_encerrar(void);
+
+#endif // !TRACE_H
@@ -12,6 +12,24 @@ double distancia(const Ponto *a, const Ponto *b, int dim) {
   return (double) sqrt(sum_of_squares);
 }
 
+double distancia2_limitada(const Ponto *a, const Ponto *b, int dim, double limite) {
+  double soma = 0;
+  int i = 0;
+  // Verifica o limite a cada 8 dimensões, para não frear o laço interno
+  for (; i + 8 <= dim; i += 8) {
+    for (int j = i; j < i + 8; j++) {
+      double dif = a->features[j] - b->features[j];
+      soma += dif * dif;
+    }
+    if (soma > limite) return soma;
+  }
+  for (; i < dim; i++) {
+    double dif = a->features[i] - b->features[i];
+    soma += dif * dif;
+  }
+  return soma;
+}
+
 void *thread_worker(void *args) {
   double dist;
   Ponto *p_ponto_treino;
@@ -37,5 +55,6 @@ void *thread_worker(void *args) {
       pthread_mutex_unlock(&p_heap->mutex);
     }
   }
-  pthread_exit(NULL);
+  // return em vez de pthread_exit: a função também roda dentro do pool
+  return NULL;
 }
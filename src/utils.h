@@ -64,4 +64,20 @@ void *thread_worker(void *args);
  */
 double distancia(const Ponto *a, const Ponto *b, int dim);
 
+/**
+ * @brief Calcula o quadrado da distância euclidiana, com abandono antecipado.
+ *
+ * @details A soma é interrompida assim que ultrapassa `limite`, pois nesse
+ * caso o valor exato não interessa a quem só aceita distâncias até o limite
+ * (busca por raio, heap cheia). Use `INFINITY` para obter sempre a soma
+ * completa.
+ *
+ * @param a Ponteiro para o primeiro ponto.
+ * @param b Ponteiro para o segundo ponto.
+ * @param dim Dimensão dos pontos (número de atributos).
+ * @param limite Maior valor de interesse para o quadrado da distância.
+ * @return O quadrado da distância, ou algum valor maior que `limite`.
+ */
+double distancia2_limitada(const Ponto *a, const Ponto *b, int dim, double limite);
+
 #endif // !UTILS_H